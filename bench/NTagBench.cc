@@ -0,0 +1,189 @@
+/*******************************************
+*
+* @file NTagBench.cc
+*
+* @brief Offline micro-benchmarks for the hit and feature kernels.
+*
+* @details Runs PMTHitCluster, VertexFitManager and CandidateTagger kernels
+* on synthetic events built by SyntheticEventGenerator from the PMT geometry
+* table bench/PMTGeometry.dat, so neither SK data nor the Fortran geometry
+* initialization is needed at run time. Building still needs the full SKOFL
+* environment, as the kernels use the SK common blocks and NTagBench is linked
+* to the whole NTag library.
+* Each event has \c -nhits signal hits from a point-like vertex and dark noise
+* of \c -dark_rate [kHz] per PMT over a \c -window [us] long event window.
+*
+* Results are written one JSON object per kernel (or CSV with \c -format \c csv)
+* to the \c -out file, or to stdout if no output file is given.
+*
+********************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ArgParser.hh"
+#include "Calculator.hh"
+#include "Candidate.hh"
+#include "CandidateTagger.hh"
+#include "NTagGlobal.hh"
+#include "PMTHitCluster.hh"
+#include "Printer.hh"
+#include "Store.hh"
+#include "SyntheticEventGenerator.hh"
+#include "TRMSFitManager.hh"
+#include "VertexFitManager.hh"
+
+typedef struct BenchResult {
+    std::string kernel;
+    unsigned int nHits;
+    std::vector<double> times; // [ns]
+} BenchResult;
+
+BenchResult Run(std::string kernel, unsigned int nHits, int nReps,
+                std::function<void()> prepare, std::function<void()> run);
+void WriteResult(std::ostream& out, const BenchResult& result, std::string format);
+
+static volatile float gSink = 0; // keeps kernel outputs alive
+
+int main(int argc, char** argv)
+{
+    ArgParser parser(argc, argv);
+    Printer msg("NTagBench");
+    Store settings;
+
+    if (!GetENV("NTAGLIBPATH").empty())
+        settings.Initialize(GetENV("NTAGLIBPATH")+"/NTagConfig");
+    settings.ReadArguments(parser);
+
+    std::string pmtTablePath = settings.GetString("pmt_table", GetENV("NTAGLIBPATH")+"/bench/PMTGeometry.dat");
+    std::string format       = settings.GetString("format", "json");
+    std::string outFilePath  = settings.GetString("out", "");
+    std::string only         = settings.GetString("kernel", "");
+    int   nSignalHits        = settings.GetInt("nhits", 20);
+    float darkRate           = settings.GetFloat("dark_rate", 4.5);  // [kHz]
+    float window             = settings.GetFloat("window", 535);     // [us]
+    int   nReps              = settings.GetInt("reps", 20);
+    int   seed               = settings.GetInt("seed", 1);
+    float deadtime           = settings.GetFloat("PMTDEADTIME", 900);
+    float tCanWidth          = settings.GetFloat("TCANWIDTH", 14);
+
+    SyntheticEventGenerator generator(pNONE);
+    generator.SetDarkRate(darkRate);
+    generator.SetSeed(seed);
+    if (!generator.ReadPMTTable(pmtTablePath))
+        msg.Print("Could not read PMT table " + pmtTablePath + ", use -pmt_table to set its path.", pERROR);
+    if (format != "json" && format != "csv")
+        msg.Print("Unknown output format " + format + ", choose json or csv.", pERROR);
+
+    std::ofstream outFile;
+    if (!outFilePath.empty()) outFile.open(outFilePath);
+    std::ostream& out = outFilePath.empty() ? std::cout : outFile;
+    if (format == "csv")
+        out << "kernel,nhits,reps,mean_ns,median_ns,min_ns,ns_per_hit\n";
+
+    TVector3 vertex(300, -200, 500);
+    float t0 = 18000;
+
+    PMTHitCluster rawHits;
+    generator.AddDarkNoise(rawHits, 0, window*1e3);
+    generator.AddHitCluster(rawHits, vertex, t0, nSignalHits);
+    auto eventHits = rawHits; eventHits.Sort();
+
+    // candidate-level clusters, sliced as in EventNTagManager
+    auto tofHits = eventHits; tofHits.SetVertex(vertex);
+    auto hitsInTCANWIDTH = tofHits.SliceRange(t0, -tCanWidth/2.-0.03, tCanWidth/2.);
+    auto hitsForFit = eventHits.SliceRange(t0+vertex.Mag()/NTagConstant::C_WATER, -520, 780);
+
+    Candidate candidate;
+    for (auto const& key: gNTagFeatures) candidate.Set(key, 0);
+    candidate.Set("NHits", hitsInTCANWIDTH.GetSize());
+    candidate.Set("FitT", 5);
+    candidate.Set("TagOut", 0.8);
+
+    CandidateTagger tagger("NTagBench", pNONE);
+    tagger.SetECuts(settings.GetString("E_CUTS", "(NHits>50)&&(FitT<20)"));
+    tagger.SetNCuts(settings.GetString("N_CUTS", "(TagOut>0.7)&&((NHits<50)||(FitT>20))"));
+
+    TRMSFitManager trmsFitter(pNONE);
+    PMTHitCluster work;
+
+    auto bench = [&](std::string kernel, unsigned int nHits, std::function<void()> prepare, std::function<void()> run)
+    {
+        if (!only.empty() && only != kernel) return;
+        WriteResult(out, Run(kernel, nHits, nReps, prepare, run), format);
+        if (!outFilePath.empty()) msg.Print("Done: " + kernel);
+    };
+    auto copyRaw   = [&]() { work = rawHits; };
+    auto copyEvent = [&]() { work = eventHits; };
+
+    bench("Sort", rawHits.GetSize(), copyRaw, [&]() { work.Sort(); gSink = work[0].t(); });
+    bench("SliceRange", eventHits.GetSize(), nullptr,
+          [&]() { gSink = eventHits.SliceRange(t0, -520, 780).GetSize(); });
+    bench("ApplyDeadtime", eventHits.GetSize(), copyEvent,
+          [&]() { gSink = work.ApplyDeadtime(deadtime).nRemoved; });
+    bench("RemoveHits", eventHits.GetSize(), copyEvent,
+          [&]() { gSink = work.RemoveHits([](const PMTHit& hit){ return hit.q() > 2; }).nRemoved; });
+    bench("SetVertex", eventHits.GetSize(), copyEvent,
+          [&]() { work.SetVertex(vertex); gSink = work[0].t(); });
+    bench("GetBetaArray", hitsInTCANWIDTH.GetSize(), nullptr,
+          [&]() { gSink = hitsInTCANWIDTH.GetBetaArray()[1]; });
+    bench("GetOpeningAngleStats", hitsInTCANWIDTH.GetSize(), nullptr,
+          [&]() { gSink = hitsInTCANWIDTH.GetOpeningAngleStats().mean; });
+    bench("GetGoodness", hitsForFit.GetSize(), nullptr,
+          [&]() { gSink = VertexFitManager::GetGoodness(hitsForFit, vertex, t0); });
+    bench("TRMSFit", hitsForFit.GetSize(), nullptr,
+          [&]() { trmsFitter.Fit(hitsForFit); gSink = trmsFitter.GetFitTime(); });
+    bench("Classify", 1, nullptr,
+          [&]() { gSink = tagger.Classify(candidate); });
+
+    return 0;
+}
+
+BenchResult Run(std::string kernel, unsigned int nHits, int nReps,
+                std::function<void()> prepare, std::function<void()> run)
+{
+    BenchResult result;
+    result.kernel = kernel;
+    result.nHits = nHits;
+
+    // one warm-up call before timing
+    if (prepare) prepare();
+    run();
+
+    for (int iRep = 0; iRep < nReps; iRep++) {
+        if (prepare) prepare();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        result.times.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    return result;
+}
+
+void WriteResult(std::ostream& out, const BenchResult& result, std::string format)
+{
+    auto times = result.times;
+    std::sort(times.begin(), times.end());
+
+    double mean = 0;
+    for (auto const& t: times) mean += t;
+    mean /= times.size();
+    double median = times[times.size()/2];
+    double nsPerHit = result.nHits ? median/result.nHits : 0;
+
+    if (format == "csv")
+        out << Form("%s,%u,%d,%.1f,%.1f,%.1f,%.3f\n",
+                    result.kernel.c_str(), result.nHits, (int)times.size(), mean, median, times.front(), nsPerHit);
+    else
+        out << Form("{\"kernel\": \"%s\", \"nhits\": %u, \"reps\": %d, "
+                    "\"mean_ns\": %.1f, \"median_ns\": %.1f, \"min_ns\": %.1f, \"ns_per_hit\": %.3f}\n",
+                    result.kernel.c_str(), result.nHits, (int)times.size(), mean, median, times.front(), nsPerHit);
+    out << std::flush;
+}
@@ -0,0 +1,43 @@
+#!/usr/bin/env python
+"""
+Writes an approximate SK-like ID PMT geometry table (PMTGeometry.dat) for NTagBench.
+
+The layout is a 20-inch PMT lattice with 70.7 cm spacing on a cylinder of
+radius 1690 cm and half-height 1810 cm: 51 rings x 150 columns on the barrel
+and the 1748 lattice points closest to the axis on each cap (11146 PMTs in total).
+It reproduces the SK ID dimensions and PMT density, not the actual cable mapping.
+"""
+
+import math
+
+RINTK, ZPINTK, SPACING = 1690.0, 1810.0, 70.7
+NRINGS, NCOLUMNS, NCAPPMTS = 51, 150, 1748
+
+def cap_points(z):
+    n = int(RINTK / SPACING) + 1
+    points = []
+    for i in range(-n, n):
+        for j in range(-n, n):
+            x, y = (i + 0.5) * SPACING, (j + 0.5) * SPACING
+            if math.hypot(x, y) < RINTK:
+                points.append((x, y, z))
+    points.sort(key=lambda p: (round(math.hypot(p[0], p[1]), 3), math.atan2(p[1], p[0])))
+    return sorted(points[:NCAPPMTS], key=lambda p: (p[1], p[0]))
+
+def main():
+    pmts = []
+    for iRing in range(NRINGS):
+        z = (iRing - (NRINGS - 1) / 2.) * SPACING
+        for iCol in range(NCOLUMNS):
+            phi = 2 * math.pi * (iCol + 0.5) / NCOLUMNS
+            pmts.append((RINTK * math.cos(phi), RINTK * math.sin(phi), z))
+    pmts = cap_points(ZPINTK) + pmts + cap_points(-ZPINTK)
+
+    with open("PMTGeometry.dat", "w") as f:
+        f.write("# Approximate SK-like ID PMT geometry for NTagBench, generated by make_pmt_geometry.py\n")
+        f.write("# cable ID, x [cm], y [cm], z [cm]\n")
+        for i, (x, y, z) in enumerate(pmts):
+            f.write("%d %.1f %.1f %.1f\n" % (i + 1, x, y, z))
+
+if __name__ == "__main__":
+    main()
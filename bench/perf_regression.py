@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""
+Performance regression check for the full NTag pipeline.
+
+Runs bin/NTag on a fixed set of synthetic events (-synthetic true) for each
+delayed vertex mode and NN type, reads the JSON profile summary written with
+-perf_json, and either stores the results as a baseline (--update) or compares
+them against the stored baseline.
+
+A configuration is flagged if its event or candidate throughput drops, or its
+peak RSS or a stage time grows, by more than --threshold (relative), or if its
+output digest (a hash of all candidate features) differs from the baseline.
+The exit code is 1 if any configuration is flagged.
+
+Examples:
+    bench/perf_regression.py --update          # write bench/perf_baseline.json
+    bench/perf_regression.py --threshold 0.2   # compare against it
+"""
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+
+NTAGLIBPATH = os.environ.get("NTAGLIBPATH", os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+# (key, higher is better)
+METRICS = [("events_per_s", True), ("candidates_per_s", True), ("peak_rss_mb", False)]
+# stages faster than this [ms/event] are too noisy to compare
+MIN_STAGE_TIME = 0.05
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--ntag", default=os.path.join(NTAGLIBPATH, "bin", "NTag"), help="NTag executable")
+    parser.add_argument("--baseline", default=os.path.join(NTAGLIBPATH, "bench", "perf_baseline.json"))
+    parser.add_argument("--update", action="store_true", help="write the baseline instead of comparing")
+    parser.add_argument("--threshold", type=float, default=0.1, help="relative regression threshold")
+    parser.add_argument("--modes", default="prompt,trms,bonsai", help="delayed vertex modes")
+    parser.add_argument("--nn", default="keras,tmva", help="NN types")
+    parser.add_argument("--events", type=int, default=200, help="number of synthetic events")
+    parser.add_argument("--seed", type=int, default=1, help="synthetic event seed")
+    parser.add_argument("--workdir", default=None, help="directory for NTag outputs (default: temporary)")
+    parser.add_argument("ntag_args", nargs="*", help="extra NTag arguments, after --")
+    return parser.parse_args()
+
+
+def run_config(args, workdir, mode, nn):
+    name = "%s_%s" % (mode, nn)
+    perf_path = os.path.join(workdir, "perf_%s.json" % name)
+    command = [args.ntag, "-synthetic", "true",
+               "-NSYNTHEVENTS", str(args.events), "-SYNTHSEED", str(args.seed),
+               "-delayed_vertex", mode, "-NN_type", nn,
+               "-out", os.path.join(workdir, "ntag_%s.root" % name),
+               "-perf_json", perf_path, "-print", "false"] + args.ntag_args
+
+    print("Running %s..." % name, flush=True)
+    with open(os.path.join(workdir, "log_%s.txt" % name), "w") as log:
+        status = subprocess.call(command, stdout=log, stderr=subprocess.STDOUT)
+    if status != 0 or not os.path.exists(perf_path):
+        print("  NTag failed (exit code %d), see %s" % (status, log.name))
+        return None
+
+    with open(perf_path) as perf_file:
+        perf = json.load(perf_file)
+    return {"events": perf["events"],
+            "events_per_s": perf["events_per_s"],
+            "candidates_per_s": perf["candidates_per_s"],
+            "peak_rss_mb": perf["peak_rss_mb"],
+            "stages_ms": {stage: value["mean_ms"] for stage, value in perf["stages"].items()},
+            "counters": perf["counters"],
+            "output_digest": perf["output_digest"]}
+
+
+def relative_change(new, old, higher_is_better):
+    if old <= 0:
+        return 0.
+    change = (new - old) / old
+    return -change if higher_is_better else change
+
+
+def compare(name, result, base, threshold):
+    problems = []
+
+    if result["output_digest"] != base["output_digest"] or result["counters"] != base["counters"]:
+        problems.append("output changed (digest %s -> %s)" % (base["output_digest"], result["output_digest"]))
+
+    for key, higher_is_better in METRICS:
+        change = relative_change(result[key], base[key], higher_is_better)
+        if change > threshold:
+            problems.append("%s: %.3g -> %.3g (%+.1f%%)" % (key, base[key], result[key],
+                                                           100*(result[key]/base[key] - 1)))
+
+    for stage, old in base["stages_ms"].items():
+        new = result["stages_ms"].get(stage, 0.)
+        if max(new, old) < MIN_STAGE_TIME:
+            continue
+        change = relative_change(new, old, False)
+        if change > threshold:
+            problems.append("%s: %.3g -> %.3g ms/event (%+.1f%%)" % (stage, old, new, 100*change))
+
+    print("%-16s %s" % (name, "OK" if not problems else "REGRESSION"))
+    for problem in problems:
+        print("    " + problem)
+    return not problems
+
+
+def main():
+    args = parse_args()
+    workdir = args.workdir or tempfile.mkdtemp(prefix="ntag_perf_")
+    if not os.path.isdir(workdir):
+        os.makedirs(workdir)
+
+    config = {"events": args.events, "seed": args.seed, "ntag_args": args.ntag_args}
+    results = {}
+    is_ok = True
+    for mode in args.modes.split(","):
+        for nn in args.nn.split(","):
+            result = run_config(args, workdir, mode, nn)
+            if result is None:
+                is_ok = False
+            else:
+                results["%s/%s" % (mode, nn)] = result
+
+    if args.update:
+        baseline = {"config": config,
+                    "machine": {"node": platform.node(), "processor": platform.processor(),
+                                "cpu_count": os.cpu_count()},
+                    "results": results}
+        with open(args.baseline, "w") as baseline_file:
+            json.dump(baseline, baseline_file, indent=2, sort_keys=True)
+            baseline_file.write("\n")
+        print("Baseline written to %s" % args.baseline)
+        return 0 if is_ok else 1
+
+    if not os.path.exists(args.baseline):
+        print("No baseline %s, run with --update first." % args.baseline)
+        return 1
+    with open(args.baseline) as baseline_file:
+        baseline = json.load(baseline_file)
+    if baseline["config"] != config:
+        print("Warning: baseline was made with %s, now running %s" % (baseline["config"], config))
+
+    for name, result in sorted(results.items()):
+        if name not in baseline["results"]:
+            print("%-16s no baseline" % name)
+            continue
+        is_ok &= compare(name, result, baseline["results"][name], args.threshold)
+
+    return 0 if is_ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
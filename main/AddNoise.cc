@@ -63,6 +63,7 @@ int main(int argc, char **argv)
         inputMCODHits.SetAsSignal();
 
         // Append dummy hits
+        noiseManager.SetInputEventIndex(eventID-1);
         noiseManager.AddIDNoise(&inputMCIDHits);
         if (settings.GetBool("add_noise_OD", false))
             noiseManager.AddODNoise(&inputMCODHits);
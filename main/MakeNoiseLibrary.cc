@@ -0,0 +1,46 @@
+#include "SuperManager.h"
+#undef MAXPM
+#undef MAXPMA
+
+#include "ArgParser.hh"
+#include "Calculator.hh"
+#include "NoiseManager.hh"
+#include "NoiseLibrary.hh"
+#include "Printer.hh"
+#include "Store.hh"
+#include "git.h"
+
+int main(int argc, char **argv)
+{
+    ArgParser parser(argc, argv);
+    Printer msg("MakeNoiseLibrary");
+    Store settings;
+
+    if (!GetENV("NTAGLIBPATH").empty())
+        settings.Initialize(GetENV("NTAGLIBPATH")+"/NTagConfig");
+    settings.ReadArguments(parser);
+    settings.Print();
+
+    auto inputNoise = settings.GetString("in");
+    auto outputFilePath = settings.GetString("out");
+
+    // Read dummy trigger files
+    NoiseManager noiseManager;
+    if (TString(inputNoise).EndsWith(".root"))
+        noiseManager.SetNoiseTreeFromWildcard(inputNoise);
+    else
+        noiseManager.SetNoiseTreeFromList(inputNoise);
+
+    msg.Print(Form("Input noise: %s", inputNoise.c_str()));
+    msg.Print(Form("Output noise library: %s", outputFilePath.c_str()));
+
+    NoiseLibrary library;
+    if (settings.GetBool("debug", false)) library.SetVerbosity(pDEBUG);
+    if (!library.Build(noiseManager.GetNoiseChain(), outputFilePath))
+        msg.Print("Failed to build noise library!", pERROR);
+
+    msg.Print(Form("Noise library done!"));
+    msg.Print(Form("Output: %s", outputFilePath.c_str()));
+
+    return 0;
+}
@@ -13,9 +13,11 @@
 
 #include "ArgParser.hh"
 #include "Printer.hh"
+#include "AsyncLogSink.hh"
 #include "SKIO.hh"
 #include "SKLibs.hh"
 #include "NoiseManager.hh"
+#include "SyntheticEventGenerator.hh"
 #include "EventNTagManager.hh"
 #include "git.h"
 
@@ -55,6 +57,25 @@ int main(int argc, char** argv)
     settings.Set("commit", gitcommit);
     settings.Set("tag", gittag);
 
+    // production preset: warnings and errors only, console written asynchronously
+    bool isQuiet = settings.GetBool("quiet", false);
+    if (isQuiet) Printer::SetMaxVerbosity(pWARNING);
+    AsyncLogSink consoleSink;
+    if (settings.GetBool("async_log", isQuiet)) {
+        consoleSink.OpenConsole();
+        consoleSink.Attach(std::cout);
+    }
+
+    // synthetic events in place of the input file
+    bool isSynthetic = settings.GetBool("synthetic", false);
+    if (isSynthetic) {
+        if (!outDataFilePath.empty())
+            msg.Print("Output data file is not supported for synthetic events!", pERROR);
+        // synthetic events use the true prompt vertex
+        if (!settings.HasKey("prompt_vertex"))
+            settings.Set("prompt_vertex", "true");
+    }
+
     // delayed mode check
     if (!settings.HasKey("delayed_vertex")) {
         msg.Print(Form("No delayed vertex option specified, "
@@ -103,12 +124,24 @@ int main(int argc, char** argv)
         ntagManager.SetOutDataFile(&output);
     }
 
-    input.OpenFile();
-    int nInputEvents = input.GetNumberOfEvents();
-    input.DumpSettings();
+    SyntheticEventGenerator generator;
+    int nInputEvents = 0;
+    if (isSynthetic) {
+        generator.ApplySettings(settings);
+        generator.OpenFile();
+        nInputEvents = generator.GetNumberOfEvents();
+        generator.DumpSettings();
+
+        msg.Print(Form("Number of synthetic events: %d", nInputEvents));
+    }
+    else {
+        input.OpenFile();
+        nInputEvents = input.GetNumberOfEvents();
+        input.DumpSettings();
 
-    msg.Print("Input file: " + inputFilePath);
-    msg.Print(Form("Number of events in input file: %d", nInputEvents));
+        msg.Print("Input file: " + inputFilePath);
+        msg.Print(Form("Number of events in input file: %d", nInputEvents));
+    }
 
     // NTagManager reads settings from the arguments
     // Settings specified in the arguments will override the default
@@ -145,9 +178,17 @@ int main(int argc, char** argv)
 
     // event loop
     for (int eventID=1; eventID<=nInputEvents; eventID++) {
-        std::cout << "\n"; msg.Print(Form("Processing Event #%d / %d...", eventID, nInputEvents));
-        input.ReadEvent(eventID);
-        ntagManager.ProcessEvent();
+        if (msg.IsPrinted(pDEFAULT)) {
+            std::cout << "\n"; msg.Print(Form("Processing Event #%d / %d...", eventID, nInputEvents));
+        }
+        {
+            ScopedTimer timer(ntagManager.GetProfiler(), sReadEvent);
+            if (isSynthetic) generator.ReadEvent(eventID);
+            else             input.ReadEvent(eventID);
+        }
+        if (noiseManager) noiseManager->SetInputEventIndex(eventID-1);
+        if (isSynthetic) ntagManager.ProcessSyntheticEvent(generator);
+        else             ntagManager.ProcessEvent();
     }
 
     // just in case the final data event was SHE without AFT
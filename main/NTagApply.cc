@@ -28,7 +28,11 @@ int main(int argc, char** argv)
     tagger.SetTMATCHWINDOW(settings.GetFloat("TMATCHWINDOW"));
     tagger.SetECuts(settings.GetString("E_CUTS"));
     tagger.SetNCuts(settings.GetString("N_CUTS"));
-    tagger.Apply(inFilePath, outFilePath, tmvaManager);
+    tagger.SetNThreads(settings.GetInt("NTHREADS", 1));
+    if (settings.GetBool("friend", false))
+        tagger.ApplyFriend(inFilePath, outFilePath, tmvaManager);
+    else
+        tagger.Apply(inFilePath, outFilePath, tmvaManager);
 
     if (tmvaManager) delete tmvaManager;
 /*
@@ -1,6 +1,8 @@
 #include <iostream>
 
 #include "NTagTMVAManager.hh"
+#include "NTagGlobal.hh"
+#include "TrainingDataset.hh"
 #include "ArgParser.hh"
 #include "Printer.hh"
 
@@ -10,13 +12,28 @@ int main(int argc, char** argv)
     const std::string inputFilePath = parser.GetOption("-in");
     const std::string outputFilePath = parser.GetOption("-out");
     const std::string outDirPath = parser.GetOption("-dir");
+    const std::string exportFilePath = parser.GetOption("-export");
+    const std::string featureSet = parser.GetOption("-features");
+    const std::string testFraction = parser.GetOption("-TESTFRACTION");
+    const std::string splitSeed = parser.GetOption("-SEED");
+    const std::string nThreads = parser.GetOption("-NTHREADS");
 
     Printer msg("NTagTrain", pDEFAULT);
 
     msg.Print("Input file: " + inputFilePath);
 
+    // export a training dataset instead of training
+    if (!exportFilePath.empty()) {
+        TrainingDataset dataset;
+        auto const& features = featureSet == "keras" ? gKerasFeatures : gTMVAFeatures;
+        return dataset.Export(inputFilePath, exportFilePath, features) < 0;
+    }
+
     NTagTMVAManager manager;
     manager.SetMethods(true);
+    manager.SetDatasetSplit(testFraction.empty() ? 0.5 : std::stof(testFraction),
+                            splitSeed.empty() ? 0 : std::stoul(splitSeed),
+                            nThreads.empty() ? 1 : std::stoi(nThreads));
     manager.TrainWeights(inputFilePath.data(), outputFilePath.data(), outDirPath.data());
 
     return 0;
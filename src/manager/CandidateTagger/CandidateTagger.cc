@@ -1,5 +1,15 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <memory>
+#include <thread>
+
 #include "TFile.h"
+#include "TFormula.h"
+#include "TROOT.h"
+#include "TThread.h"
 #include "TTree.h"
+#include "TLeaf.h"
 #include "TTreeFormula.h"
 
 #include "NTagGlobal.hh"
@@ -9,8 +19,12 @@
 #include "NTagTMVAManager.hh"
 #include "EventNTagManager.hh"
 
+// minimum number of entries re-tagged at once by CandidateTagger::TagEntries
+static const long MINCHUNKSIZE = 1000;
+
 CandidateTagger::CandidateTagger(std::string fitterName, Verbosity verbose)
-: fECuts("0"), fNCuts("0"), fECutFormula(nullptr), fNCutFormula(nullptr), TMATCHWINDOW(50),
+: fNThreads(1), fECuts("0"), fNCuts("0"), fECutFormula(nullptr), fNCutFormula(nullptr), fPrefitCutFormula(nullptr),
+  fECutFunction(nullptr), fNCutFunction(nullptr), fPrefitCutFunction(nullptr), TMATCHWINDOW(50),
   fMsg(fitterName.c_str(), verbose)
 {
     fName = fitterName;
@@ -33,18 +47,46 @@ CandidateTagger::~CandidateTagger()
     delete fOutputTree;
     delete fECutFormula;
     delete fNCutFormula;
+    delete fPrefitCutFormula;
+    delete fECutFunction;
+    delete fNCutFunction;
+    delete fPrefitCutFunction;
 }
 
 void CandidateTagger::SetECuts(std::string cuts)
 {
     fECuts = cuts;
+    delete fECutFormula;
+    delete fECutFunction;
     fECutFormula = new TTreeFormula("e cuts", fECuts.c_str(), fOutputTree);
+    fECutFunction = MakeCutFunction("e cut function", fECuts, fECutFormula, fECutFeatures);
 }
 
 void CandidateTagger::SetNCuts(std::string cuts)
 {
     fNCuts = cuts;
+    delete fNCutFormula;
+    delete fNCutFunction;
     fNCutFormula = new TTreeFormula("n cuts", fNCuts.c_str(), fOutputTree);
+    fNCutFunction = MakeCutFunction("n cut function", fNCuts, fNCutFormula, fNCutFeatures);
+}
+
+void CandidateTagger::SetPrefitCuts(std::string cuts)
+{
+    fPrefitCuts = cuts;
+    delete fPrefitCutFormula;
+    delete fPrefitCutFunction;
+    fPrefitCutFormula = nullptr;
+    fPrefitCutFunction = nullptr;
+    if (!fPrefitCuts.empty()) {
+        fPrefitCutFormula = new TTreeFormula("prefit cuts", fPrefitCuts.c_str(), fOutputTree);
+        fPrefitCutFunction = MakeCutFunction("prefit cut function", fPrefitCuts, fPrefitCutFormula, fPrefitCutFeatures);
+
+        // features not set before the fit would silently read as 0
+        for (auto const& feature: fPrefitCutFeatures)
+            if (std::find(gPrefitFeatures.begin(), gPrefitFeatures.end(), feature) == gPrefitFeatures.end())
+                fMsg.Print("Prefit cuts use " + feature + ", which is not a prefit feature!", pERROR);
+    }
 }
 
 void CandidateTagger::Apply(std::string inFilePath, std::string outFilePath, NTagTMVAManager* tmvaManager)
@@ -85,56 +127,19 @@ void CandidateTagger::Apply(std::string inFilePath, std::string outFilePath, NTa
     TaggableTree taggableTreeReader(inTaggableTree);
 
     // Replace old output with new one
-    int nTaggedE, nTaggedN;
-    std::vector<float> tagOutList;
-    std::vector<int>   tagClassList;
-    std::vector<int>   taggedTypeList;
-    TBranch* newNTaggedE         = outEventTree->Branch("NTaggedE", &nTaggedE);
-    TBranch* newNTaggedN         = outEventTree->Branch("NTaggedN", &nTaggedN);
-    TBranch* newOutBranch        = outNtagTree->Branch("TagOut", &tagOutList);
-    TBranch* newClassBranch      = outNtagTree->Branch("TagClass", &tagClassList);
-    TBranch* newTaggedTypeBranch = outTaggableTree->Branch("TaggedType", &taggedTypeList);
-
-    long nEntries = inNtagTree->GetEntries();
-
-    for (long iEntry = 0; iEntry < nEntries; iEntry++) {
-
-        fMsg.Print(Form("Processing entry %ld / %ld...\r", iEntry, nEntries), pDEFAULT, false);
-        std::cout << std::flush;
-
-        nTaggedE = 0; nTaggedN = 0;
-        tagOutList.clear();
-        tagClassList.clear();
-        taggedTypeList.clear();
-
-        ntagTreeReader.GetEntry(iEntry);
-        taggableTreeReader.GetEntry(iEntry);
-
-        for (auto& candidate: ntagTreeReader.cluster) {
-            float tagOut = tmvaManager? tmvaManager->GetTMVAOutput(candidate) : 0;
-            candidate.Set("TagOut", tagOut);
-            int tagClass = Classify(candidate);
-            candidate.Set("TagClass", tagClass);
-            tagOutList.push_back(tagOut);
-            tagClassList.push_back(tagClass);
-        }
-
-        nTaggedE = std::count_if(tagClassList.begin(), tagClassList.end(), [](int tagclass){ return tagclass==typeE; });
-        nTaggedN = std::count_if(tagClassList.begin(), tagClassList.end(), [](int tagclass){ return tagclass==typeN; });
-
-        EventNTagManager::ResetTaggableMapping(taggableTreeReader.cluster);
-        EventNTagManager::Map(taggableTreeReader.cluster, ntagTreeReader.cluster, TMATCHWINDOW);
-
-        for (auto const& taggable: taggableTreeReader.cluster) {
-            taggedTypeList.push_back(taggable.TaggedType());
-        }
+    TBranch* newNTaggedE         = outEventTree->Branch("NTaggedE", &fResult.nTaggedE);
+    TBranch* newNTaggedN         = outEventTree->Branch("NTaggedN", &fResult.nTaggedN);
+    TBranch* newOutBranch        = outNtagTree->Branch("TagOut", &fResult.tagOutList);
+    TBranch* newClassBranch      = outNtagTree->Branch("TagClass", &fResult.tagClassList);
+    TBranch* newTaggedTypeBranch = outTaggableTree->Branch("TaggedType", &fResult.taggedTypeList);
 
+    TagEntries(ntagTreeReader, taggableTreeReader, tmvaManager, [&](long iEntry) {
         newNTaggedE->Fill();
         newNTaggedN->Fill();
         newOutBranch->Fill();
         newClassBranch->Fill();
         newTaggedTypeBranch->Fill();
-    }
+    });
 
     outSettingsTree->Write();
     outEventTree->Write();
@@ -151,6 +156,170 @@ void CandidateTagger::Apply(std::string inFilePath, std::string outFilePath, NTa
     fMsg.Print(fName + " application complete!                ");
 }
 
+void CandidateTagger::ApplyFriend(std::string inFilePath, std::string outFilePath, NTagTMVAManager* tmvaManager)
+{
+    TFile* inFile = TFile::Open(inFilePath.c_str());
+    TTree* inEventTree    = (TTree*)inFile->Get("event");
+    TTree* inTaggableTree = (TTree*)inFile->Get("taggable");
+    TTree* inNtagTree     = (TTree*)inFile->Get("ntag");
+
+    // read only the candidate features needed for scoring, classification, and mapping
+    std::vector<std::string> ntagBranches = {"NHits", "FitT", "fvx", "fvy", "fvz"};
+    if (tmvaManager)
+        ntagBranches.insert(ntagBranches.end(), gTMVAFeatures.begin(), gTMVAFeatures.end());
+    for (auto const& feature: GetCutFeatures())
+        if (feature != "TagOut" && feature != "TagClass") // re-evaluated
+            ntagBranches.push_back(feature);
+
+    inNtagTree->SetBranchStatus("*", 0);
+    for (auto const& branchName: ntagBranches)
+        if (inNtagTree->GetBranch(branchName.c_str()))
+            inNtagTree->SetBranchStatus(branchName.c_str(), 1);
+
+    inTaggableTree->SetBranchStatus("TaggedType", 0);
+    inTaggableTree->SetBranchStatus("DistFromPV", 0);
+    inTaggableTree->SetBranchStatus("DWall", 0);
+
+    int eventNo = 0;
+    inEventTree->SetBranchStatus("*", 0);
+    inEventTree->SetBranchStatus("EventNo", 1);
+    inEventTree->SetBranchAddress("EventNo", &eventNo);
+
+    NTagTree ntagTreeReader(inNtagTree);
+    TaggableTree taggableTreeReader(inTaggableTree);
+
+    TFile* outFile = new TFile(outFilePath.c_str(), "recreate");
+    TTree* outSettingsTree = new TTree("settings", "settings");
+    TTree* outEventTree    = new TTree("event", "event");
+    TTree* outTaggableTree = new TTree("taggable", "taggable");
+    TTree* outNtagTree     = new TTree("ntag", "ntag");
+
+    outSettingsTree->Branch("source", &inFilePath);
+    outSettingsTree->Branch("E_CUTS", &fECuts);
+    outSettingsTree->Branch("N_CUTS", &fNCuts);
+    outSettingsTree->Branch("TMATCHWINDOW", &TMATCHWINDOW);
+    outSettingsTree->Fill();
+
+    outEventTree->Branch("EventNo", &eventNo);
+    outEventTree->Branch("NTaggedE", &fResult.nTaggedE);
+    outEventTree->Branch("NTaggedN", &fResult.nTaggedN);
+    outNtagTree->Branch("TagOut", &fResult.tagOutList);
+    outNtagTree->Branch("TagClass", &fResult.tagClassList);
+    outTaggableTree->Branch("TaggedType", &fResult.taggedTypeList);
+
+    TagEntries(ntagTreeReader, taggableTreeReader, tmvaManager, [&](long iEntry) {
+        inEventTree->GetEntry(iEntry);
+        outEventTree->Fill();
+        outNtagTree->Fill();
+        outTaggableTree->Fill();
+    });
+
+    outFile->cd();
+    outSettingsTree->Write();
+    outEventTree->Write();
+    outTaggableTree->Write();
+    outNtagTree->Write();
+
+    outFile->Close();
+    inFile->Close();
+
+    fMsg.Print(fName + " application complete!                ");
+}
+
+void CandidateTagger::TagEntries(NTagTree& ntagTree, TaggableTree& taggableTree, NTagTMVAManager* tmvaManager,
+                                 std::function<void(long)> fillEntry)
+{
+    // TMVA readers of the other threads, made in this thread as ROOT objects
+    // and kept out of the output file
+    TDirectory* outDirectory = gDirectory;
+    gROOT->cd();
+    std::vector<std::unique_ptr<NTagTMVAManager>> tmvaManagers;
+    for (int iThread=1; tmvaManager && iThread<fNThreads; iThread++) {
+        tmvaManagers.emplace_back(new NTagTMVAManager());
+        tmvaManagers.back()->InitializeReader(tmvaManager->GetWeightPath());
+    }
+    outDirectory->cd();
+    if (fNThreads > 1) TThread::Initialize();
+
+    long nEntries = ntagTree.fChain->GetEntries();
+    std::vector<CandidateCluster> candidateClusters;
+    std::vector<TaggableCluster> taggableClusters;
+    std::vector<TagResult> results;
+
+    auto clusterIterator = ntagTree.fChain->GetClusterIterator(0);
+    long chunkStart = 0;
+    while (chunkStart < nEntries) {
+
+        // read whole clusters until the chunk is large enough
+        long chunkEnd = chunkStart;
+        while (chunkEnd < nEntries && chunkEnd - chunkStart < MINCHUNKSIZE*fNThreads) {
+            clusterIterator();
+            chunkEnd = clusterIterator.GetNextEntry();
+        }
+        chunkEnd = std::min(chunkEnd, nEntries);
+
+        long chunkSize = chunkEnd - chunkStart;
+        candidateClusters.resize(chunkSize);
+        taggableClusters.resize(chunkSize);
+        results.resize(chunkSize);
+        for (long iEntry=chunkStart; iEntry<chunkEnd; iEntry++) {
+            ntagTree.GetEntry(iEntry);
+            taggableTree.GetEntry(iEntry);
+            candidateClusters[iEntry-chunkStart] = ntagTree.cluster;
+            taggableClusters[iEntry-chunkStart] = taggableTree.cluster;
+        }
+
+        // re-tag the chunk
+        std::atomic<long> nextEntry(0);
+        auto tagChunk = [&](int iThread) {
+            NTagTMVAManager* reader = iThread && tmvaManager ? tmvaManagers[iThread-1].get() : tmvaManager;
+            for (long i = nextEntry++; i < chunkSize; i = nextEntry++)
+                results[i] = TagEntry(candidateClusters[i], taggableClusters[i], reader);
+        };
+        std::vector<std::thread> threads;
+        for (int iThread=1; iThread<fNThreads; iThread++)
+            threads.emplace_back(tagChunk, iThread);
+        tagChunk(0);
+        for (auto& thread: threads) thread.join();
+
+        // write in entry order
+        for (long iEntry=chunkStart; iEntry<chunkEnd; iEntry++) {
+            std::swap(fResult, results[iEntry-chunkStart]);
+            fillEntry(iEntry);
+        }
+
+        fMsg.Print(Form("Processing entry %ld / %ld...\r", chunkEnd, nEntries), pDEFAULT, false);
+        std::cout << std::flush;
+        chunkStart = chunkEnd;
+    }
+}
+
+TagResult CandidateTagger::TagEntry(CandidateCluster& candidates, TaggableCluster& taggables, NTagTMVAManager* tmvaManager)
+{
+    TagResult result;
+
+    for (auto& candidate: candidates) {
+        float tagOut = tmvaManager? tmvaManager->GetTMVAOutput(candidate) : 0;
+        candidate.Set("TagOut", tagOut);
+        int tagClass = Classify(candidate);
+        candidate.Set("TagClass", tagClass);
+        result.tagOutList.push_back(tagOut);
+        result.tagClassList.push_back(tagClass);
+    }
+
+    result.nTaggedE = std::count_if(result.tagClassList.begin(), result.tagClassList.end(), [](int tagclass){ return tagclass==typeE; });
+    result.nTaggedN = std::count_if(result.tagClassList.begin(), result.tagClassList.end(), [](int tagclass){ return tagclass==typeN; });
+
+    EventNTagManager::ResetTaggableMapping(taggables);
+    EventNTagManager::Map(taggables, candidates, TMATCHWINDOW);
+
+    for (auto const& taggable: taggables) {
+        result.taggedTypeList.push_back(taggable.TaggedType());
+    }
+
+    return result;
+}
+
 void CandidateTagger::OverrideSettings(std::string outFilePath)
 {
     TFile* f = new TFile(outFilePath.c_str(), "UPDATE");
@@ -174,15 +343,67 @@ void CandidateTagger::OverrideSettings(std::string outFilePath)
 
 int CandidateTagger::Classify(const Candidate& candidate)
 {
-    for (auto const& pair: candidate.GetFeatureMap())
-        fFeatureMap[pair.first] = pair.second;
-
-    FillTree();
-
     int tagClass = typeMissed;
-    if      (fECutFormula->EvalInstance()) tagClass = typeE;
-    else if (fNCutFormula->EvalInstance()) tagClass = typeN;
+    if      (PassCuts(fECutFunction, fECutFeatures, candidate)) tagClass = typeE;
+    else if (PassCuts(fNCutFunction, fNCutFeatures, candidate)) tagClass = typeN;
 
-    ClearTree();
     return tagClass;
-}
\ No newline at end of file
+}
+
+TFormula* CandidateTagger::MakeCutFunction(const char* name, const std::string& cuts, TTreeFormula* formula,
+                                           std::vector<std::string>& features)
+{
+    features.clear();
+    for (int iCode=0; iCode<formula->GetNcodes(); iCode++) {
+        if (!formula->GetLeaf(iCode)) continue;
+        std::string feature = formula->GetLeaf(iCode)->GetName();
+        if (std::find(features.begin(), features.end(), feature) == features.end())
+            features.push_back(feature);
+    }
+
+    // replace feature names with parameters, e.g., "NHits>50" -> "[0]>50"
+    std::string expression;
+    for (unsigned int iChar=0; iChar<cuts.size();) {
+        if (std::isalnum(cuts[iChar]) || cuts[iChar] == '_') {
+            unsigned int iEnd = iChar;
+            while (iEnd < cuts.size() && (std::isalnum(cuts[iEnd]) || cuts[iEnd] == '_' || cuts[iEnd] == '.')) iEnd++;
+            // numbers, e.g., "1e3", are kept as they are
+            auto word = cuts.substr(iChar, iEnd-iChar);
+            auto iter = std::find(features.begin(), features.end(), word);
+            expression += iter == features.end() ? word : std::string(Form("[%d]", (int)(iter-features.begin())));
+            iChar = iEnd;
+        }
+        else expression += cuts[iChar++];
+    }
+
+    return new TFormula(name, expression.c_str());
+}
+
+bool CandidateTagger::PassCuts(TFormula* function, const std::vector<std::string>& features, const Candidate& candidate)
+{
+    std::vector<double> parameters;
+    for (auto const& feature: features)
+        parameters.push_back(candidate.Get(feature));
+
+    double x[1] = {0};
+    return function->EvalPar(x, parameters.data());
+}
+
+std::vector<std::string> CandidateTagger::GetCutFeatures() const
+{
+    std::vector<std::string> features;
+    for (auto const& formula: {fECutFormula, fNCutFormula, fPrefitCutFormula}) {
+        if (!formula) continue;
+        for (int iCode=0; iCode<formula->GetNcodes(); iCode++)
+            if (formula->GetLeaf(iCode))
+                features.push_back(formula->GetLeaf(iCode)->GetName());
+    }
+    return features;
+}
+
+bool CandidateTagger::PassPrefitCuts(const Candidate& candidate)
+{
+    if (!fPrefitCutFunction) return true;
+
+    return PassCuts(fPrefitCutFunction, fPrefitCutFeatures, candidate);
+}
@@ -1,13 +1,29 @@
 #ifndef CANDIDATETAGGER_HH
 #define CANDIDATETAGGER_HH
 
+#include <functional>
+
 #include "TCut.h"
 
 #include "TreeOut.hh"
 #include "Candidate.hh"
 #include "Printer.hh"
 
+class TFormula;
 class NTagTMVAManager;
+class NTagTree;
+class TaggableTree;
+
+/**
+ * @brief Re-evaluated tagging output of an NTag output file entry.
+ * @see CandidateTagger::Apply
+ */
+typedef struct TagResult {
+    int nTaggedE, nTaggedN;
+    std::vector<float> tagOutList;
+    std::vector<int>   tagClassList;
+    std::vector<int>   taggedTypeList;
+} TagResult;
 
 class CandidateTagger : public TreeOut
 {
@@ -17,22 +33,82 @@ class CandidateTagger : public TreeOut
 
         void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
         void SetTMATCHWINDOW(float t) { TMATCHWINDOW = t; }
+        /**
+         * @brief Sets the number of threads that re-tag entries in CandidateTagger::Apply and ApplyFriend.
+         * @details Entries are read and written by the calling thread in chunks of whole TTree clusters,
+         * and each chunk is re-tagged by \c nThreads threads. The cuts are evaluated without touching
+         * any tree (see CandidateTagger::Classify), and each thread has its own TMVA reader
+         * with the weights of the given NTagTMVAManager, as a reader can't be shared between threads.
+         */
+        void SetNThreads(int nThreads) { fNThreads = nThreads < 1 ? 1 : nThreads; }
         void SetECuts(std::string cuts="0");
         void SetNCuts(std::string cuts="0");
+        void SetPrefitCuts(std::string cuts="");
+        bool HasPrefitCuts() const { return fPrefitCutFormula != nullptr; }
 
         virtual void Apply(std::string inFilePath, std::string outFilePath, NTagTMVAManager* tmvaManager=0);
+        /**
+         * @brief Re-tags an NTag output file like CandidateTagger::Apply, but reads only the branches
+         * needed for scoring, classification, and taggable mapping, and writes only the re-evaluated
+         * branches to \c outFilePath as friend trees of the input trees.
+         * @details The output file has the trees \c ntag (\c TagOut, \c TagClass),
+         * \c taggable (\c TaggedType), and \c event (\c NTaggedE, \c NTaggedN, and \c EventNo
+         * of the input event tree as an index), with one entry per input entry,
+         * and a \c settings tree with the input file path (\c source) and the new tagging conditions.
+         */
+        virtual void ApplyFriend(std::string inFilePath, std::string outFilePath, NTagTMVAManager* tmvaManager=0);
         virtual void OverrideSettings(std::string outFilePath);
 
+        /**
+         * @brief Classifies the candidate with the e/n cuts.
+         * @details The cuts are compiled once into TFormula objects with the features as parameters,
+         * so evaluation only reads the candidate and can run on multiple threads.
+         */
         virtual int Classify(const Candidate& candidate);
 
+        /**
+         * @brief Evaluates the pre-fit cuts on features that do not need a fitted vertex.
+         * @return \c true if the candidate should go through the delayed vertex fit.
+         */
+        bool PassPrefitCuts(const Candidate& candidate);
+
+        /**
+         * @brief Returns the names of the features used in the e/n/pre-fit cuts.
+         */
+        std::vector<std::string> GetCutFeatures() const;
+
     protected:
         float TMATCHWINDOW;
 
     private:
+        TagResult TagEntry(CandidateCluster& candidates, TaggableCluster& taggables, NTagTMVAManager* tmvaManager);
+        /**
+         * @brief Re-tags all entries of \c ntagTree and \c taggableTree, and calls \c fillEntry
+         * for each entry in entry order with CandidateTagger::fResult set to the entry's result.
+         */
+        void TagEntries(NTagTree& ntagTree, TaggableTree& taggableTree, NTagTMVAManager* tmvaManager,
+                        std::function<void(long)> fillEntry);
+
+        /**
+         * @brief Compiles \c cuts into a TFormula whose parameters are the features of \c formula, in \c features.
+         */
+        TFormula* MakeCutFunction(const char* name, const std::string& cuts, TTreeFormula* formula,
+                                  std::vector<std::string>& features);
+        bool PassCuts(TFormula* function, const std::vector<std::string>& features, const Candidate& candidate);
+
+        int fNThreads;
+        TagResult fResult; // output of the entry being filled
+
         std::string fECuts;
         std::string fNCuts;
+        std::string fPrefitCuts;
         TTreeFormula* fECutFormula;
         TTreeFormula* fNCutFormula;
+        TTreeFormula* fPrefitCutFormula;
+        TFormula* fECutFunction;
+        TFormula* fNCutFunction;
+        TFormula* fPrefitCutFunction;
+        std::vector<std::string> fECutFeatures, fNCutFeatures, fPrefitCutFeatures;
         std::map<std::string, float> fFeatureMap;
 
         std::string fName;
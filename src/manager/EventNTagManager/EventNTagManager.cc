@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iomanip>
 
 #include "TFile.h"
@@ -30,11 +31,13 @@
 #include "NTagBankIO.hh"
 #include "Calculator.hh"
 #include "NoiseManager.hh"
+#include "SyntheticEventGenerator.hh"
 #include "EventNTagManager.hh"
 
 EventNTagManager::EventNTagManager(Verbosity verbose)
 : fOutDataFile(nullptr), fNoiseManager(nullptr),
-  fIsBranchSet(false), fIsMC(true), fDoAutoRefRun(true), fFileFormat(mZBS)
+  fIsBranchSet(false), fIsMC(true), fIsSynthetic(false), fDoAutoRefRun(true), fIsEventLoopInitialized(false),
+  fFileFormat(mZBS)
 {
     fMsg = Printer("NTagManager", verbose);
 
@@ -45,9 +48,13 @@ EventNTagManager::EventNTagManager(Verbosity verbose)
     fEventVariables = Store("Variables");
     fEventCandidates = CandidateCluster("Delayed");
     fEventEarlyCandidates = CandidateCluster("Early");
+    fEventPrefitCandidates = CandidateCluster("Prefit");
 
     fEventCandidates.RegisterFeatureNames(gNTagFeatures);
     fEventEarlyCandidates.RegisterFeatureNames(gMuechkFeatures);
+    fEventPrefitCandidates.RegisterFeatureNames(gPrefitFeatures);
+
+    ResetStream();
 
     auto handler = new TInterruptHandler(this);
     handler->Add();
@@ -192,14 +199,13 @@ void EventNTagManager::ReadVariables()
                   ((skhead_.idtgsk & 1<<28) ? tSHE :
                   ((skhead_.idtgsk & 1<< 1) ?  tHE : 
                   ((skhead_.idtgsk & 1<< 0) ?  tLE : tELSE))));
-    static double prevEvTime = 0;
     double globalTime =  (skhead_.nt48sk[0] * std::pow(2, 32)
                         + skhead_.nt48sk[1] * std::pow(2, 16)
                         + skhead_.nt48sk[2]) * 20 * 1e-6;      // [ms]
-    double tDiff = globalTime - prevEvTime;
+    double tDiff = globalTime - fStream.prevEvTime;
     fEventVariables.Set("TrgType", trgtype);
     fEventVariables.Set("TDiff", tDiff);
-    prevEvTime = globalTime;
+    fStream.prevEvTime = globalTime;
 
     // reconstructed information
     // prompt vertex
@@ -242,10 +248,12 @@ void EventNTagManager::ReadVariables()
 
 void EventNTagManager::ReadHits()
 {
-    fEventHits = PMTHitCluster(sktqz_);
+    fEventHits.Clear();
+    fEventHits.AddSKTQZ(sktqz_);
     fEventHits.Sort();
 
-    fEventODHits = PMTHitCluster(sktqaz_);
+    fEventODHits.Clear();
+    fEventODHits.AddSKTQAZ(sktqaz_);
     fEventODHits.Sort();
 }
 
@@ -296,9 +304,8 @@ void EventNTagManager::AddHits()
         lastODHit = fEventODHits.GetLastHit();
     }
 
-    static int it0sk_prev = 0;
-    float tOffset = fEventHits.IsEmpty() ? 0 : (skheadqb_.it0sk - it0sk_prev) / 1.92;
-    it0sk_prev = skheadqb_.it0sk;
+    float tOffset = fEventHits.IsEmpty() ? 0 : (skheadqb_.it0sk - fStream.prevIT0SK) / 1.92;
+    fStream.prevIT0SK = skheadqb_.it0sk;
 
     fMsg.Print(Form("tOffset_it0sk: %3.2f ns", tOffset), pDEBUG);
 
@@ -307,12 +314,13 @@ void EventNTagManager::AddHits()
 
     fEventVariables.Set("HitAppendError", 0);
     if (fEventHits.IsEmpty()) {
-        fEventHits.Append(PMTHitCluster(sktqz_) + tOffset, true);
-        fEventODHits.Append(PMTHitCluster(sktqaz_) + tOffset, true);
+        fEventHits.AddSKTQZ(sktqz_, tOffset, true);
+        fEventODHits.AddSKTQAZ(sktqaz_, tOffset, true);
     }
     else {
-        auto hitsToAdd = PMTHitCluster(sktqz_) + tOffset;
-        auto odHitsToAdd = PMTHitCluster(sktqaz_) + tOffset;
+        PMTHitCluster hitsToAdd, odHitsToAdd;
+        hitsToAdd.AddSKTQZ(sktqz_, tOffset);
+        odHitsToAdd.AddSKTQAZ(sktqaz_, tOffset);
 
         bool idAddOK = fEventHits.AppendByCoincidence(hitsToAdd);
         bool odAddOK = fEventODHits.AppendByCoincidence(odHitsToAdd);
@@ -404,17 +412,50 @@ void EventNTagManager::ReadInfoFromCommon()
 
 void EventNTagManager::ReadEventFromCommon()
 {
+    fProfiler.Start(sAddHits);
     AddHits();
+    fProfiler.Stop(sAddHits);
     if (fSettings.GetBool("add_noise", false)) {
         fEventHits.SetAsSignal(true);
+        ScopedTimer timer(fProfiler, sAddNoise);
         AddNoise();
     }
     ReadInfoFromCommon();
 }
 
+void EventNTagManager::ReadEventFromGenerator(const SyntheticEventGenerator& generator)
+{
+    fProfiler.Start(sAddHits);
+    fEventHits = generator.GetHits();
+    fEventODHits.Clear();
+    fProfiler.Stop(sAddHits);
+
+    fEventVariables.Set("RunNo", 999999);
+    fEventVariables.Set("SubrunNo", 0);
+    fEventVariables.Set("EventNo", generator.GetCurrentEventID());
+    fEventVariables.Set("TrgType", tELSE);
+    fEventVariables.Set("HitAppendError", 0);
+
+    // the true prompt vertex stands in for the prompt fit
+    fPromptVertex = generator.GetPromptVertex();
+    fEventVariables.Set("pvx", fPromptVertex.x());
+    fEventVariables.Set("pvy", fPromptVertex.y());
+    fEventVariables.Set("pvz", fPromptVertex.z());
+    fEventVariables.Set("DWall", GetDWall(fPromptVertex));
+    fEventVariables.Set("vecvx", fPromptVertex.x());
+    fEventVariables.Set("vecvy", fPromptVertex.y());
+    fEventVariables.Set("vecvz", fPromptVertex.z());
+    fEventVariables.Set("VtxRes", 0);
+    fEventVariables.Set("MCT0", generator.GetPromptTime()*1e-3);
+
+    fEventTaggables = generator.GetTaggables();
+}
+
 void EventNTagManager::SearchAndFill()
 {
+    fProfiler.Start(sPrepareEventHits);
     PrepareEventHits();
+    fProfiler.Stop(sPrepareEventHits);
 
     int nhitac = fEventVariables.GetInt("NHITAC");
     int nodhitmx = fSettings.GetInt("NODHITMX");
@@ -423,14 +464,20 @@ void EventNTagManager::SearchAndFill()
         fMsg.Print(Form("Skipping search for this event (EventNo: %d)", fEventVariables.GetInt("EventNo")), pWARNING);
     }
     else {
+        ScopedTimer timer(fProfiler, sSearchCandidates);
         SearchCandidates();
     }
 
     fEventVariables.Set("NCandidates", fEventCandidates.GetSize()+fEventEarlyCandidates.GetSize());
+    if (fTagger.HasPrefitCuts())
+        fEventVariables.Set("NPrefitRejected", fEventPrefitCandidates.GetSize());
 
     FillNTagCommon();
     DumpEvent();
+    WriteEventSummary();
+    fProfiler.Start(sFillTrees);
     FillTrees();
+    fProfiler.Stop(sFillTrees);
     if (fSettings.GetBool("write_bank")) {
         FillNTAGBank();
         //std::cout << "Filling following NTAG bank\n";
@@ -442,32 +489,20 @@ void EventNTagManager::SearchAndFill()
         fOutDataFile->Write();
     }
 
+    fProfiler.Count(cHits, fEventHits.GetSize());
+    fProfiler.Count(cCandidates, fEventCandidates.GetSize());
+    fProfiler.EndEvent();
+
     ClearData();
 }
 
 void EventNTagManager::ProcessEvent()
 {
-    static bool initialized = false;
     fSettings.Set("SKGEOMETRY", SKIO::GetSKGeometry());
 
-    if (!initialized) {
+    if (!fIsEventLoopInitialized) {
         CheckMC();
-        auto nnType = fSettings.GetString("NN_type");
-        auto weightPath = fSettings.GetString("weight");
-        auto delayedMode = fSettings.GetString("delayed_vertex");
-        if (nnType=="tmva") {
-            if (weightPath=="default")
-                weightPath = delayedMode;
-            fTMVAManager.InitializeReader(weightPath);
-        }
-        else if (nnType=="keras") {
-            if (weightPath=="default") {
-                auto delayedKerasModel = (delayedMode=="lowfit"? std::string("bonsai") : delayedMode);
-                weightPath = GetENV("NTAGLIBPATH") + Form("weights/keras/sk%d/", SKIO::GetSKGeometry()) + delayedKerasModel;
-            }
-            fKerasManager.LoadWeights(weightPath);
-        }
-        initialized = true;
+        InitializeEventLoop();
     }
 
     if (fIsMC || fSettings.GetBool("force_flat"))
@@ -476,15 +511,58 @@ void EventNTagManager::ProcessEvent()
         ProcessDataEvent();
 }
 
+void EventNTagManager::ProcessSyntheticEvent(const SyntheticEventGenerator& generator)
+{
+    fSettings.Set("SKGEOMETRY", SKIO::GetSKGeometry());
+
+    if (!fIsEventLoopInitialized) {
+        fIsMC = true;
+        fIsSynthetic = true;
+        InitializeEventLoop();
+    }
+
+    ReadEventFromGenerator(generator);
+    SearchAndFill();
+}
+
+void EventNTagManager::InitializeEventLoop()
+{
+    fIsEventLoopInitialized = true;
+
+    // fork LOWFIT workers before the NN libraries start their threads
+    int nLOWFITWorkers = fSettings.GetInt("NLOWFITWORKERS", 0);
+    if (fDelayedVertexMode == mLOWFIT && nLOWFITWorkers > 1)
+        fLOWFITWorkerPool.Start(nLOWFITWorkers, &fBonsaiManager);
+
+    auto fitCachePath = fSettings.GetString("fit_cache");
+    if (!fitCachePath.empty() && fDelayedVertexMode != mPROMPT)
+        fFitResultCache.Open(fitCachePath);
+
+    auto nnType = fSettings.GetString("NN_type");
+    auto weightPath = fSettings.GetString("weight");
+    auto delayedMode = fSettings.GetString("delayed_vertex");
+    if (nnType=="tmva") {
+        if (weightPath=="default")
+            weightPath = delayedMode;
+        fTMVAManager.InitializeReader(weightPath);
+    }
+    else if (nnType=="keras") {
+        if (weightPath=="default") {
+            auto delayedKerasModel = (delayedMode=="lowfit"? std::string("bonsai") : delayedMode);
+            weightPath = GetENV("NTAGLIBPATH") + Form("weights/keras/sk%d/", SKIO::GetSKGeometry()) + delayedKerasModel;
+        }
+        fKerasManager.LoadWeights(weightPath);
+    }
+}
+
 void EventNTagManager::ProcessDataEvent()
 {
-    static int prevEvTrg = tELSE;
     int thisEvTrg = ((skhead_.idtgsk & (1<<29)) ? tAFT : ((skhead_.idtgsk & (1<<28)) ? tSHE : tELSE));
     //fMsg.Print(Form("This evtrg: %d", thisEvTrg), pWARNING);
 
     // if current event is AFT, append TQ and fill output.
     if (thisEvTrg == tAFT) {
-        if (prevEvTrg == tSHE) {
+        if (fStream.prevEvTrg == tSHE) {
             //fMsg.Print("Appending AFT to previous SHE", pWARNING);
             fEventVariables.Set("TrgType", thisEvTrg);
             AddHits();
@@ -515,7 +593,17 @@ void EventNTagManager::ProcessDataEvent()
         ProcessFlatEvent();
     }
 
-    prevEvTrg = thisEvTrg;
+    fStream.prevEvTrg = thisEvTrg;
+}
+
+void EventNTagManager::ResetStream()
+{
+    fStream.prevEvTime = 0;
+    fStream.prevIT0SK = 0;
+    fStream.prevEvTrg = tELSE;
+
+    // SHE hits waiting for an AFT of the previous stream
+    ClearData();
 }
 
 void EventNTagManager::ProcessFlatEvent()
@@ -532,6 +620,8 @@ void EventNTagManager::SearchCandidates()
     int   N200Previous    = 0;
     Float t0Previous      = std::numeric_limits<Float>::min();
 
+    std::vector<unsigned int> peakHitIndices;
+
     int nEventHits = fEventVariables.GetInt("NAllHits");
     int nIDHitsMax = fSettings.GetInt("NIDHITMX", std::numeric_limits<int>::max());
 
@@ -573,7 +663,7 @@ void EventNTagManager::SearchCandidates()
             // Also check if N200Previous is below N200 cut and if t0Previous is over t0 threshold
             if (t0New - t0Previous > TMINPEAKSEP) {
                 if (iHitPrevious >= 0 && N200Previous < N200MX && t0Previous > T0TH) {
-                    FindDelayedCandidate(iHitPrevious);
+                    peakHitIndices.push_back(iHitPrevious);
                 }
                 // Reset NHitsPrevious,
                 // if peaks are separated enough
@@ -591,19 +681,44 @@ void EventNTagManager::SearchCandidates()
 
         // Save the last peak
         if (NHitsPrevious >= NHITSTH)
-            FindDelayedCandidate(iHitPrevious);
+            peakHitIndices.push_back(iHitPrevious);
+
+        // Reject obvious noise before the delayed vertex fit
+        if (fTagger.HasPrefitCuts()) {
+            std::vector<unsigned int> passedHitIndices;
+            for (auto const& iHit: peakHitIndices)
+                if (PassPrefitCuts(iHit)) passedHitIndices.push_back(iHit);
+            peakHitIndices = passedHitIndices;
+        }
+
+        // Fit all peaks at once if LOWFIT workers are available
+        std::vector<FitResult> fitResults(peakHitIndices.size());
+        std::vector<bool> isFitted(peakHitIndices.size(), false);
+        if (fLOWFITWorkerPool.IsRunning())
+            FitInWorkerPool(peakHitIndices, fitResults, isFitted);
+
+        for (unsigned int iPeak=0; iPeak<peakHitIndices.size(); iPeak++)
+            FindDelayedCandidate(peakHitIndices[iPeak], isFitted[iPeak] ? &fitResults[iPeak] : nullptr);
     }
     if (!fEventEarlyCandidates.IsEmpty()) PruneCandidates();
     /*if (fIsMC)*/  MapTaggables();
 
     fEventEarlyCandidates.FillVectorMap();
     fEventCandidates.FillVectorMap();
+    fEventPrefitCandidates.FillVectorMap();
 }
 
 void EventNTagManager::MapTaggables()
 {
     Map(fEventTaggables, fEventEarlyCandidates, TMATCHWINDOW);
     Map(fEventTaggables, fEventCandidates, TMATCHWINDOW);
+
+    // label rejected candidates with a copy of the taggables
+    // so that the tagged types of the taggables are not affected
+    if (!fEventPrefitCandidates.IsEmpty()) {
+        TaggableCluster taggables = fEventTaggables;
+        Map(taggables, fEventPrefitCandidates, TMATCHWINDOW);
+    }
 }
 
 void EventNTagManager::ResetTaggableMapping(TaggableCluster& taggableCluster)
@@ -635,6 +750,11 @@ void EventNTagManager::ApplySettings()
         fFileFormat = mZBS;
 
     if (fSettings.GetBool("debug")) fMsg.SetVerbosity(pDEBUG);
+    fProfiler.SetEnabled(fSettings.GetBool("profile", false) || !fSettings.GetString("perf_json", "").empty());
+
+    auto eventSummaryPath = fSettings.GetString("event_summary", "");
+    if (!eventSummaryPath.empty() && !fEventSummary.Open(eventSummaryPath))
+        fMsg.Print("Could not open " + eventSummaryPath + " to write the event summary!", pWARNING);
 
     //fSettings.Set("SKGEOMETRY", SKIO::GetSKGeometry());
 
@@ -661,6 +781,7 @@ void EventNTagManager::ApplySettings()
     // tagging conditions
     fTagger.SetECuts(fSettings.GetString("E_CUTS"));
     fTagger.SetNCuts(fSettings.GetString("N_CUTS"));
+    fTagger.SetPrefitCuts(fSettings.GetString("PREFIT_CUTS"));
 
     // vertex mode
     std::string promptVertexMode, delayedVertexMode;
@@ -780,6 +901,8 @@ void EventNTagManager::MakeTrees(TFile* outfile)
     TTree* taggableTree = new TTree("taggable", "taggable");
     TTree* nTree        = new TTree("ntag", "ntag");
     TTree* eTree        = new TTree("mue", "mue");
+    TTree* prefitTree   = fTagger.HasPrefitCuts() ? new TTree("prefit", "prefit") : nullptr;
+    TTree* perfTree     = fProfiler.IsEnabled() ? new TTree("perf", "perf") : nullptr;
 
     if (outfile) {
         settingsTree->SetDirectory(outfile);
@@ -789,6 +912,8 @@ void EventNTagManager::MakeTrees(TFile* outfile)
         taggableTree->SetDirectory(outfile);
         nTree->SetDirectory(outfile);
         eTree->SetDirectory(outfile);
+        if (prefitTree) prefitTree->SetDirectory(outfile);
+        if (perfTree) perfTree->SetDirectory(outfile);
     }
 
     fSettings.SetTree(settingsTree);
@@ -798,6 +923,8 @@ void EventNTagManager::MakeTrees(TFile* outfile)
     fEventTaggables.SetTree(taggableTree);
     fEventCandidates.SetTree(nTree);
     fEventEarlyCandidates.SetTree(eTree);
+    if (prefitTree) fEventPrefitCandidates.SetTree(prefitTree);
+    if (perfTree) fProfiler.SetTree(perfTree);
 }
 
 void EventNTagManager::FillTrees()
@@ -812,6 +939,8 @@ void EventNTagManager::FillTrees()
         fEventTaggables.MakeBranches();
         fEventEarlyCandidates.MakeBranches();
         fEventCandidates.MakeBranches();
+        fEventPrefitCandidates.MakeBranches();
+        fProfiler.MakeBranches();
 
         // settings should be filled only once
         fSettings.FillTree();
@@ -825,6 +954,15 @@ void EventNTagManager::FillTrees()
     fEventTaggables.FillTree();
     fEventEarlyCandidates.FillTree();
     fEventCandidates.FillTree();
+    fEventPrefitCandidates.FillTree();
+
+    // fold the tagging output into the profiler's output digest
+    if (fProfiler.IsEnabled()) {
+        fProfiler.AddToDigest(fEventVariables.GetInt("EventNo", 0));
+        for (auto const& candidate: fEventCandidates)
+            for (auto const& pair: candidate.GetFeatureMap())
+                fProfiler.AddToDigest(pair.second);
+    }
 }
 
 void EventNTagManager::WriteTrees(bool doCloseFile)
@@ -838,7 +976,23 @@ void EventNTagManager::WriteTrees(bool doCloseFile)
     fEventTaggables.WriteTree();
     fEventEarlyCandidates.WriteTree();
     fEventCandidates.WriteTree();
+    fEventPrefitCandidates.WriteTree();
+    fProfiler.WriteTree();
     if (doCloseFile) outFile->Close();
+
+    if (fFitResultCache.IsOpen()) {
+        fFitResultCache.DumpStatistics();
+        fFitResultCache.Save();
+    }
+
+    fProfiler.PrintSummary();
+    fEventSummary.Close();
+
+    auto perfJSONPath = fSettings.GetString("perf_json", "");
+    if (!perfJSONPath.empty())
+        fProfiler.WriteJSON(perfJSONPath, {{"delayed_vertex", fSettings.GetString("delayed_vertex")},
+                                           {"NN_type",        fSettings.GetString("NN_type")},
+                                           {"commit",         fSettings.GetString("commit", "")}});
 }
 
 void EventNTagManager::ClearData()
@@ -850,10 +1004,14 @@ void EventNTagManager::ClearData()
     fEventTaggables.Clear();
     fEventCandidates.Clear();
     fEventEarlyCandidates.Clear();
+    fEventPrefitCandidates.Clear();
 }
 
 void EventNTagManager::DumpEvent()
 {
+    // nothing to format if the event summary is not printed
+    if (!fMsg.IsPrinted(pDEFAULT)) return;
+
     bool debug = fSettings.GetBool("debug", false);
     std::cout << "\n\n\n\n";
     if (debug) fEventVariables.Print();
@@ -867,6 +1025,27 @@ void EventNTagManager::DumpEvent()
     }
 }
 
+void EventNTagManager::WriteEventSummary()
+{
+    if (!fEventSummary.IsOpen()) return;
+
+    int nTaggedE = 0, nTaggedN = 0;
+    for (auto const& candidates: {&fEventEarlyCandidates, &fEventCandidates}) {
+        for (auto const& candidate: *candidates) {
+            auto tagClass = static_cast<TaggableType>((int)(candidate.Get("TagClass", -1)+0.5f));
+            if      (tagClass == typeE) nTaggedE++;
+            else if (tagClass == typeN) nTaggedN++;
+        }
+    }
+
+    fEventSummary.Write(Form("{\"run\": %d, \"subrun\": %d, \"event\": %d, \"nhits\": %d, \"ncandidates\": %d, "
+                             "\"ntaggables\": %d, \"ne\": %d, \"nn\": %d}\n",
+                             fEventVariables.GetInt("RunNo"), fEventVariables.GetInt("SubrunNo"),
+                             fEventVariables.GetInt("EventNo"), fEventVariables.GetInt("NAllHits"),
+                             fEventVariables.GetInt("NCandidates"), fEventTaggables.GetSize(),
+                             nTaggedE, nTaggedN));
+}
+
 void EventNTagManager::DumpEventVariables()
 {
     fMsg.PrintBlock("Event summary", pSUBEVENT, pDEFAULT, false);
@@ -982,47 +1161,64 @@ void EventNTagManager::ResetEventHitsVertex()
 void EventNTagManager::PrepareEventHits()
 {
     // fetch bad channels, dark rates
-    FindReferenceRun();
+    // (synthetic events come with their own dark rates and no bad channels)
+    if (!fIsSynthetic)
+        FindReferenceRun();
 
     // Beginning of PMT hit reduction:
-    // 4 reduction steps
+    // 4 reduction steps, applied in a single pass over the hits
     // (1) Remove bad PMT channels
     // (2) Apply PMT deadtime
     // (3) Remove negative Q hits
     // (4) Remove large Q hits (optional, affects only search range)
+    // QISMSK is summed over the remaining hits in the same pass
 
-    std::vector<HitReductionResult> idHitReducRes;
-    std::vector<HitReductionResult> odHitReducRes;
+    auto negativeQCut = [](PMTHit const & hit){ return (hit.q()<0); };
+
+    fIDHitReduction.Clear();
+    fODHitReduction.Clear();
 
     // (1) Remove bad PMT channels
     bool doRemoveBad = TString(fSettings.GetString("SKOPTN")).Contains("25");
-
-    int nBadIDHits = 0;
     if (doRemoveBad) {
-        idHitReducRes.push_back(fEventHits.RemoveBadChannels());
-        odHitReducRes.push_back(fEventODHits.RemoveBadChannels());
-        nBadIDHits = idHitReducRes.back().nRemoved;
+        fIDHitReduction.AddCut("Bad PMTs", fEventHits.GetBadChannelCut());
+        fODHitReduction.AddCut("Bad PMTs", fEventODHits.GetBadChannelCut());
     }
-    fEventVariables.Set("NBadHits", nBadIDHits);
 
     // (2) Apply PMT deadtime
-    idHitReducRes.push_back(fEventHits.ApplyDeadtime(PMTDEADTIME, true));
-    fEventVariables.Set("NDeadHitsByNoise",  idHitReducRes.back().nRemovedByNoise);
-    fEventVariables.Set("NDeadHitsBySignal", idHitReducRes.back().nRemovedBySignal);
-    fEventHits.SetBurstFlag(TRBNWIDTH);
+    fIDHitReduction.AddDeadtime(&fDeadtimeFilter, PMTDEADTIME, TRBNWIDTH);
 
     // (3) Remove negative Q hits
-    idHitReducRes.push_back(fEventHits.RemoveNegativeHits());
-    odHitReducRes.push_back(fEventODHits.RemoveNegativeHits());
-    fEventVariables.Set("NNegativeHits", idHitReducRes.back().nRemoved);
+    fIDHitReduction.AddCut("Q < 0", negativeQCut);
+    fODHitReduction.AddCut("Q < 0", negativeQCut);
 
     // (4) Remove large Q hits (optional, affects only search range)
-    if (fSettings.HasKey("QMAX")) {
-        ResetEventHitsVertex();
-        idHitReducRes.push_back(fEventHits.RemoveLargeQHits(QMAX, T0TH, T0MX));
-        fEventVariables.Set("NLargeQHits", idHitReducRes.back().nRemoved);
+    bool doRemoveLargeQ = fSettings.HasKey("QMAX");
+    if (doRemoveLargeQ) {
+        fIDHitReduction.AddCut(Form("Q > %3.2f", QMAX), [=](PMTHit const & hit){ return (hit.q()>QMAX); },
+                               T0TH, T0MX, true);
+        if (fSettings.GetBool("correct_tof", true))
+            fIDHitReduction.SetVertex(fPromptVertex);
+        else
+            fIDHitReduction.RemoveVertex();
     }
 
+    // qismsk
+    float tGateMin = fSettings.GetFloat("TGATEMIN")*1e3 + 1000.;
+    float tGateMax = fSettings.GetFloat("TGATEMAX")*1e3 + 1000.;
+    fIDHitReduction.SetQSumRange(tGateMin, tGateMax);
+
+    std::vector<HitReductionResult> idHitReducRes = fIDHitReduction.Apply(fEventHits);
+    std::vector<HitReductionResult> odHitReducRes = fODHitReduction.Apply(fEventODHits);
+
+    unsigned int iStep = 0;
+    fEventVariables.Set("NBadHits", doRemoveBad ? (int)idHitReducRes[iStep++].nRemoved : 0);
+    fEventVariables.Set("NDeadHitsByNoise",  idHitReducRes[iStep].nRemovedByNoise);
+    fEventVariables.Set("NDeadHitsBySignal", idHitReducRes[iStep++].nRemovedBySignal);
+    fEventVariables.Set("NNegativeHits", idHitReducRes[iStep++].nRemoved);
+    if (doRemoveLargeQ)
+        fEventVariables.Set("NLargeQHits", idHitReducRes[iStep++].nRemoved);
+
     ResetEventHitsVertex();
     int allIDSize = fEventHits.CountRange(T0TH, T0MX);
     int allODSize = fEventODHits.CountRange(T0TH, T0MX);
@@ -1030,40 +1226,26 @@ void EventNTagManager::PrepareEventHits()
     fEventVariables.Set("NAllODHits", allODSize);
 
     // print out hit reduction results
-    std::cout << "\n";
-    fMsg.Print("ID hit reduction results:");
-    DumpHitReductionResults(idHitReducRes);
-    fMsg.Print(Form("Remaining ID hits in search range [%4.0f, %4.0f] usec (correct_tof = %s): ",
-                    T0TH*1e-3-1, T0MX*1e-3-1, fSettings.GetString("correct_tof").c_str()));
-    fMsg.Print(Form("%d / %d hits\n", allIDSize, fEventHits.GetSize()));
-
-    fMsg.Print("OD hit reduction results:");
-    DumpHitReductionResults(odHitReducRes);
-    fMsg.Print(Form("Remaining OD hits in search range [%6.2f, %6.2f] usec: ",
-                    T0TH*1e-3-1, T0MX*1e-3-1));
-    fMsg.Print(Form("%d / %d hits\n", allODSize, fEventODHits.GetSize()));
+    if (fMsg.IsPrinted(pDEFAULT)) {
+        std::cout << "\n";
+        fMsg.Print("ID hit reduction results:");
+        DumpHitReductionResults(idHitReducRes);
+        fMsg.Print(Form("Remaining ID hits in search range [%4.0f, %4.0f] usec (correct_tof = %s): ",
+                        T0TH*1e-3-1, T0MX*1e-3-1, fSettings.GetString("correct_tof").c_str()));
+        fMsg.Print(Form("%d / %d hits\n", allIDSize, fEventHits.GetSize()));
+
+        fMsg.Print("OD hit reduction results:");
+        DumpHitReductionResults(odHitReducRes);
+        fMsg.Print(Form("Remaining OD hits in search range [%6.2f, %6.2f] usec: ",
+                        T0TH*1e-3-1, T0MX*1e-3-1));
+        fMsg.Print(Form("%d / %d hits\n", allODSize, fEventODHits.GetSize()));
+    }
 
     // End of hit reduction
     // Set event variables
 
-    // qismsk
-    fEventHits.RemoveVertex();
-    fEventHits.Sort();
-
-    float qismsk = 0;
-    float tGateMin = fSettings.GetFloat("TGATEMIN")*1e3 + 1000.;
-    float tGateMax = fSettings.GetFloat("TGATEMAX")*1e3 + 1000.;
-    for (auto const& hit: fEventHits) {
-        float hitTime = hit.t();
-        if (tGateMin < hitTime && hitTime < tGateMax) {
-            //std::cout << hit.t() << " " << hit.i() << " " << hit.q() << std::endl;
-            qismsk += hit.q();
-        }
-    }
-
     // qismsk = skq_.qismsk;
-    fEventVariables.Set("QISMSK", qismsk);
-    ResetEventHitsVertex();
+    fEventVariables.Set("QISMSK", fIDHitReduction.GetQSum());
 
     //fEventHits.DumpAllElements();
     //fEventODHits.DumpAllElements();
@@ -1072,13 +1254,21 @@ void EventNTagManager::PrepareEventHits()
     fEventVariables.Set("NHITAC", nhitac);
 
     // ODMaxN200
-    auto odT = fEventODHits.GetProjection(HitFunc::T);
-    int nBins = int((T0MX-T0TH)/200.);
-    float remainderT = fmod(T0MX-T0TH, 200.);
-    auto odHist = Histogram(odT, nBins, T0TH+remainderT/2., T0MX-remainderT/2.);
     int odMaxN200 = 0;
-    for (auto const& pair: odHist) {
-        if (pair.second > odMaxN200) odMaxN200 = pair.second;
+    if (fSettings.GetBool("binned_n200", false)) {
+        // fixed 200 ns bins, for compatibility with older outputs
+        auto odT = fEventODHits.GetProjection(HitFunc::T);
+        int nBins = int((T0MX-T0TH)/200.);
+        float remainderT = fmod(T0MX-T0TH, 200.);
+        auto odHist = Histogram(odT, nBins, T0TH+remainderT/2., T0MX-remainderT/2.);
+        for (auto const& pair: odHist) {
+            if (pair.second > odMaxN200) odMaxN200 = pair.second;
+        }
+    }
+    else {
+        fEventODHits.Sort();
+        odMaxN200 = GetMaxNInWindow(fEventODHits.begin(), fEventODHits.end(),
+                                    [](const PMTHit& hit){ return hit.t(); }, 200., T0TH, T0MX);
     }
     fEventVariables.Set("ODMaxN200", odMaxN200);
 
@@ -1095,7 +1285,38 @@ void EventNTagManager::PrepareEventHits()
 //    fEventHits.RemoveVertex();
 //}
 
-void EventNTagManager::FindDelayedCandidate(unsigned int iHit)
+bool EventNTagManager::PassPrefitCuts(unsigned int iHit)
+{
+    // features that do not need a fitted vertex, evaluated at the prompt vertex
+    Float canTime = fEventHits[iHit].t() + TWIDTH/2.;
+    auto hitsInTCANWIDTH = fEventHits.SliceRange(canTime, -TCANWIDTH/2.-0.03, TCANWIDTH/2.);
+    auto hitsIn200ns     = fEventHits.SliceRange(canTime,               -100,         +100);
+
+    Candidate candidate(fEventHits[iHit].GetHitID());
+    candidate.Set("FitT", (canTime-1000)*1e-3);
+    candidate.Set("NHits", hitsInTCANWIDTH.GetSize());
+    candidate.Set("N200",  hitsIn200ns.GetSize());
+    candidate.Set("TRMS", hitsInTCANWIDTH.Find(HitFunc::T, Calc::RMS));
+    candidate.Set("QSum", hitsInTCANWIDTH.Find(HitFunc::Q, Calc::Sum));
+    candidate.Set("NBurst", hitsInTCANWIDTH.GetNBurst());
+    candidate.Set("BurstRatio", hitsInTCANWIDTH.GetBurstRatio());
+    candidate.Set("DarkLikelihood", hitsInTCANWIDTH.GetDarkLikelihood());
+    candidate.Set("NNoisyPMT", hitsInTCANWIDTH.GetNNoisyPMT());
+    candidate.Set("NoisyPMTRatio", hitsInTCANWIDTH.GetNoisyPMTRatio());
+    candidate.Set("fvx", fPromptVertex.x());
+    candidate.Set("fvy", fPromptVertex.y());
+    candidate.Set("fvz", fPromptVertex.z());
+    candidate.Set("DWall", GetDWall(fPromptVertex));
+
+    if (fTagger.PassPrefitCuts(candidate))
+        return true;
+
+    // keep rejected candidates to measure the efficiency loss
+    fEventPrefitCandidates.Append(candidate);
+    return false;
+}
+
+void EventNTagManager::FindDelayedCandidate(unsigned int iHit, const FitResult* fitResult)
 {
     PMTHit firstHit = fEventHits[iHit];
     auto trgHits = fEventHits.Slice(iHit, TWIDTH);
@@ -1126,27 +1347,34 @@ void EventNTagManager::FindDelayedCandidate(unsigned int iHit)
 
         // BONSAI
         else if (fDelayedVertexMode == mBONSAI || fDelayedVertexMode == mLOWFIT) {
-            fEventHits.RemoveVertex();
-            fEventHits.Sort();
             firstHit.UnsetToFAndDirection();
-            unsigned int firstHitID = fEventHits.GetIndex(firstHit);
-            Float tLeft  = fDelayedVertexMode == mLOWFIT ? -520 : -500;
-            Float tRight = fDelayedVertexMode == mLOWFIT ?  780 : 1000;
-            hitsForFit = fEventHits.Slice(firstHitID, TWIDTH/2.+tLeft, TWIDTH/2.+tRight) - firstHit.t() + 1000;
-
-            // give up bonsai fit for N1300 larger than 2000
-            auto nHitsForFit = hitsForFit.GetSize();
-            if (nHitsForFit > 2000) {
-                fMsg.Print(Form("A possible candidate at T=%3.2f us has N%d=%d that is larger than 2000,"
-                                " giving up fit and setting the delayed vertex the same as the prompt vertex (%3.2f, %3.2f, %3.2f)...",
-                                firstHit.t()*1e-3, int(tRight-tLeft), nHitsForFit, delayedVertex.x(), delayedVertex.y(), delayedVertex.z()), pWARNING);
-                doFit = false;
+
+            if (!fitResult) {
+                fEventHits.RemoveVertex();
+                fEventHits.Sort();
+                hitsForFit = SliceHitsForFit(firstHit);
+
+                // give up bonsai fit for N1300 larger than 2000
+                auto nHitsForFit = hitsForFit.GetSize();
+                if (nHitsForFit > 2000) {
+                    Float tLeft  = fDelayedVertexMode == mLOWFIT ? -520 : -500;
+                    Float tRight = fDelayedVertexMode == mLOWFIT ?  780 : 1000;
+                    fMsg.Print(Form("A possible candidate at T=%3.2f us has N%d=%d that is larger than 2000,"
+                                    " giving up fit and setting the delayed vertex the same as the prompt vertex (%3.2f, %3.2f, %3.2f)...",
+                                    firstHit.t()*1e-3, int(tRight-tLeft), nHitsForFit, delayedVertex.x(), delayedVertex.y(), delayedVertex.z()), pWARNING);
+                    doFit = false;
+                }
             }
         }
 
         if (doFit) {
-            hitsForFit.Sort();
-            fDelayedVertexManager->Fit(hitsForFit);
+            // fit already done by LOWFIT workers
+            if (fitResult)
+                fDelayedVertexManager->SetFitResult(*fitResult);
+            else {
+                hitsForFit.Sort();
+                FitDelayedVertex(hitsForFit);
+            }
             delayedVertex   = fDelayedVertexManager->GetFitVertex();
             delayedTime     = fDelayedVertexManager->GetFitTime() + firstHit.t() - 1000;
             delayedGoodness = fDelayedVertexManager->GetFitGoodness();
@@ -1170,7 +1398,7 @@ void EventNTagManager::FindDelayedCandidate(unsigned int iHit)
         unsigned int nHits = fEventHits.SliceRange(delayedTime, -TCANWIDTH/2.-0.03, TCANWIDTH/2.).GetSize();
 
         if (nHits >= MINNHITS && nHits <= MAXNHITS) {
-            Candidate candidate(iHit);
+            Candidate candidate(firstHit.GetHitID());
             candidate.Set("FitT", (delayedTime-1000)*1e-3); // -1000 ns is to offset the trigger time T=1000 ns
             candidate.Set("FitGoodness", delayedGoodness);
             candidate.Set("BSenergy", fBonsaiManager.GetFitEnergy());
@@ -1184,8 +1412,88 @@ void EventNTagManager::FindDelayedCandidate(unsigned int iHit)
     ResetEventHitsVertex();
 }
 
+PMTHitCluster EventNTagManager::SliceHitsForFit(const PMTHit& firstHit)
+{
+    // fEventHits and firstHit should be without ToF correction
+    unsigned int firstHitID = fEventHits.GetIndex(firstHit);
+    Float tLeft  = fDelayedVertexMode == mLOWFIT ? -520 : -500;
+    Float tRight = fDelayedVertexMode == mLOWFIT ?  780 : 1000;
+    return fEventHits.Slice(firstHitID, TWIDTH/2.+tLeft, TWIDTH/2.+tRight) - firstHit.t() + 1000;
+}
+
+void EventNTagManager::FitDelayedVertex(const PMTHitCluster& hitsForFit)
+{
+    ScopedTimer timer(fProfiler, sVertexFit);
+    fProfiler.Count(cVertexFits);
+
+    if (!fFitResultCache.IsOpen()) {
+        fDelayedVertexManager->Fit(hitsForFit);
+        return;
+    }
+
+    FitResult result;
+    auto key = FitResultCache::GetKey(fDelayedVertexManager->GetConfigString(), hitsForFit);
+    if (fFitResultCache.Find(key, hitsForFit.GetSize(), result))
+        fDelayedVertexManager->SetFitResult(result);
+    else {
+        fDelayedVertexManager->Fit(hitsForFit);
+        fFitResultCache.Insert(key, hitsForFit.GetSize(), fDelayedVertexManager->GetFitResult());
+    }
+}
+
+void EventNTagManager::FitInWorkerPool(const std::vector<unsigned int>& peakHitIndices,
+                                       std::vector<FitResult>& fitResults, std::vector<bool>& isFitted)
+{
+    ScopedTimer timer(fProfiler, sVertexFit);
+    fProfiler.Count(cVertexFits, peakHitIndices.size());
+
+    std::vector<PMTHit> firstHits;
+    for (auto const& iHit: peakHitIndices)
+        firstHits.push_back(fEventHits[iHit]);
+
+    fEventHits.RemoveVertex();
+    fEventHits.Sort();
+
+    // windows larger than 2000 hits are left to FindDelayedCandidate,
+    // and windows found in the fit cache are not sent to the workers
+    std::string fitterConfig = fBonsaiManager.GetConfigString();
+    std::vector<PMTHitCluster> hitWindows;
+    std::vector<unsigned int> peakIndices;
+    std::vector<uint64_t> cacheKeys;
+    for (unsigned int iPeak=0; iPeak<firstHits.size(); iPeak++) {
+        auto& firstHit = firstHits[iPeak];
+        firstHit.UnsetToFAndDirection();
+        auto hitsForFit = SliceHitsForFit(firstHit);
+        if (hitsForFit.GetSize() > LOWFITMAXHITS) continue;
+        hitsForFit.Sort();
+
+        if (fFitResultCache.IsOpen()) {
+            auto key = FitResultCache::GetKey(fitterConfig, hitsForFit);
+            if (fFitResultCache.Find(key, hitsForFit.GetSize(), fitResults[iPeak])) {
+                isFitted[iPeak] = true;
+                continue;
+            }
+            cacheKeys.push_back(key);
+        }
+        hitWindows.push_back(hitsForFit);
+        peakIndices.push_back(iPeak);
+    }
+
+    ResetEventHitsVertex();
+
+    auto results = fLOWFITWorkerPool.Fit(hitWindows);
+    for (unsigned int iWindow=0; iWindow<results.size(); iWindow++) {
+        fitResults[peakIndices[iWindow]] = results[iWindow];
+        isFitted[peakIndices[iWindow]] = true;
+        if (fFitResultCache.IsOpen())
+            fFitResultCache.Insert(cacheKeys[iWindow], hitWindows[iWindow].GetSize(), results[iWindow]);
+    }
+}
+
 void EventNTagManager::FindFeatures(Candidate& candidate, Float canTime)
 {
+    ScopedTimer timer(fProfiler, sFindFeatures);
+
     //unsigned int firstHitID = candidate.HitID();
     //float fitTime = candidate.Get("FitT")*1e3 + 1000;
     auto hitsInTCANWIDTH = fEventHits.SliceRange(canTime, -TCANWIDTH/2.-0.03, TCANWIDTH/2.);
@@ -1275,20 +1583,24 @@ void EventNTagManager::FindFeatures(Candidate& candidate, Float canTime)
     candidate.Set("NNoisyPMT", hitsInTCANWIDTH.GetNNoisyPMT());
     candidate.Set("NoisyPMTRatio", hitsInTCANWIDTH.GetNoisyPMTRatio());
 
+    fProfiler.Start(sNNInference);
     auto nnType = fSettings.GetString("NN_type");
     float tagOut = nnType=="tmva"  ? fTMVAManager.GetTMVAOutput(candidate) :
                    nnType=="keras" ? fKerasManager.GetOutput(candidate)    : 0;
+    fProfiler.Stop(sNNInference);
 
     candidate.Set("TagOut", tagOut);
+    fProfiler.Start(sClassify);
     auto tagClass = fTagger.Classify(candidate);
+    fProfiler.Stop(sClassify);
     candidate.Set("TagClass", tagClass);
 
     if (tagClass>0) {
-        auto allHitT = fEventHits.GetProjection(HitFunc::T);
-        std::vector<float> hitT(allHitT.begin(), allHitT.end());
-
-        auto hitIndex = GetRangeIndex(hitT, float(canTime-TCANWIDTH/2.-0.03), float(canTime+TCANWIDTH/2.));
-        for (auto i: hitIndex) {
+        // hits are sorted by ToF-subtracted time
+        unsigned int iLow = fEventHits.GetLowerBoundIndex(canTime-TCANWIDTH/2.-0.03);
+        unsigned int iEnd = std::upper_bound(fEventHits.begin(), fEventHits.end(), PMTHit(canTime+TCANWIDTH/2., 0, 1, 1))
+                            - fEventHits.begin();
+        for (unsigned int i=iLow; i<iEnd; i++) {
             fEventHits.At(i).SetTagFlag(1);
             //fEventHits[i].Dump();
         }
@@ -1299,6 +1611,18 @@ void EventNTagManager::Map(TaggableCluster& taggableCluster, CandidateCluster& c
 {
     std::string key = candidateCluster.GetName();
 
+    // taggables inside the tank, sorted by time
+    std::vector<std::pair<float, int>> taggableTimes;
+    for (unsigned int iTaggable=0; iTaggable<taggableCluster.GetSize(); iTaggable++) {
+        auto& taggable = taggableCluster[iTaggable];
+        if (GetDWall(taggable.Vertex()) > 0)
+            taggableTimes.push_back({taggable.Time(), iTaggable});
+    }
+    std::sort(taggableTimes.begin(), taggableTimes.end());
+
+    // taggable time range scanned for each candidate, with a margin of 1 ns for rounding
+    float tScanWindow = tMatchWindow*1e-3 + 1e-3; // [us]
+
     for (unsigned int iCandidate=0; iCandidate<candidateCluster.GetSize(); iCandidate++) {
 
         auto& candidate = candidateCluster[iCandidate];
@@ -1311,24 +1635,26 @@ void EventNTagManager::Map(TaggableCluster& taggableCluster, CandidateCluster& c
         //bool hasMatchingE = false;
         //bool hasMatchingG = false;
 
-        std::vector<int> taggableIndexList;
-        std::vector<float> matchTimeList;
-
-        //taggableIndexList.clear();
-        //matchTimeList.clear();
-        for (unsigned int iTaggable=0; iTaggable<taggableCluster.GetSize(); iTaggable++) {
-            auto& taggable = taggableCluster[iTaggable];
-            float tDiff = fabs(taggable.Time() - candidate["FitT"]);
-            if (tDiff*1e3 < tMatchWindow && GetDWall(taggable.Vertex())>0) {
-                matchTimeList.push_back(tDiff);
-                taggableIndexList.push_back(iTaggable);
+        // find the closest taggable in time within the match window,
+        // the one with the smallest index if tied
+        float fitT = candidate["FitT"];
+        int iMinMatchTimeCapture = -1;
+        float minMatchTime = 0;
+        auto scanStart = std::lower_bound(taggableTimes.begin(), taggableTimes.end(),
+                                          std::make_pair(fitT - tScanWindow, -1));
+        for (auto iter = scanStart; iter != taggableTimes.end() && iter->first < fitT + tScanWindow; ++iter) {
+            float tDiff = fabs(iter->first - fitT);
+            if (tDiff*1e3 < tMatchWindow &&
+                (iMinMatchTimeCapture < 0 || tDiff < minMatchTime ||
+                 (tDiff == minMatchTime && iter->second < iMinMatchTimeCapture))) {
+                minMatchTime = tDiff;
+                iMinMatchTimeCapture = iter->second;
             }
         }
 
-        if (!matchTimeList.empty()) {
+        if (iMinMatchTimeCapture >= 0) {
 
             // closest taggable is matched to the given candidate
-            int iMinMatchTimeCapture = taggableIndexList[GetMinIndex(matchTimeList)];
             auto& taggable = taggableCluster[iMinMatchTimeCapture];
 
             // candidate label determined by taggable type
@@ -4,18 +4,35 @@
 #include "SKLibs.hh"
 #include "SKIO.hh"
 #include "PMTHitCluster.hh"
+#include "DeadtimeFilter.hh"
+#include "HitReductionPipeline.hh"
 #include "ParticleCluster.hh"
 #include "TaggableCluster.hh"
 #include "CandidateCluster.hh"
 #include "TRMSFitManager.hh"
 #include "BonsaiManager.hh"
+#include "LOWFITWorkerPool.hh"
+#include "FitResultCache.hh"
 #include "NTagTMVAManager.hh"
 #include "NTagKerasManager.hh"
 #include "Printer.hh"
+#include "AsyncLogSink.hh"
+#include "Profiler.hh"
 #include "Store.hh"
 #include "NTagGlobal.hh"
 
 class NoiseManager;
+class SyntheticEventGenerator;
+
+/**
+ * @brief Event-to-event state of an input stream, e.g., to append AFT hits to the preceding SHE event.
+ * @see EventNTagManager::ResetStream
+ */
+typedef struct StreamContext {
+    double prevEvTime; ///< global time of the previous event [ms]
+    int prevIT0SK;     ///< it0sk of the previous event whose hits were added
+    int prevEvTrg;     ///< trigger type (tSHE, tAFT, or tELSE) of the previous data event
+} StreamContext;
 
 class EventNTagManager
 {
@@ -35,6 +52,7 @@ class EventNTagManager
         // read
         void ReadInfoFromCommon();
         void ReadEventFromCommon();
+        void ReadEventFromGenerator(const SyntheticEventGenerator& generator);
         // process
         void SearchAndFill();
 
@@ -42,6 +60,18 @@ class EventNTagManager
         void ProcessEvent();
         void ProcessDataEvent();
         void ProcessFlatEvent();
+        void ProcessSyntheticEvent(const SyntheticEventGenerator& generator);
+
+        /**
+         * @brief Starts a new input stream (e.g., the next input file),
+         * forgetting the previous event and clearing any unfilled SHE hits.
+         */
+        void ResetStream();
+        const StreamContext& GetStreamContext() const { return fStream; }
+        /**
+         * @brief Continues a stream from \c context, e.g., that of the previous shard of the same run.
+         */
+        void SetStreamContext(const StreamContext& context) { fStream = context; }
         
         // bad channel settings
         void PrepareEventHits();
@@ -69,6 +99,10 @@ class EventNTagManager
         void DumpEvent();
         void DumpEventVariables();
         void DumpHitReductionResults(std::vector<HitReductionResult> resVec);
+        /**
+         * @brief Writes a one-line JSON summary of the event to the \c event_summary file.
+         */
+        void WriteEventSummary();
 
         // getters
         Store& GetSettings() { return fSettings; };
@@ -78,6 +112,8 @@ class EventNTagManager
         TaggableCluster& GetTaggables() { return fEventTaggables; }
         CandidateCluster& GetEarlyCandidates() { return fEventEarlyCandidates; }
         CandidateCluster& GetCandidates() { return fEventCandidates; }
+        CandidateCluster& GetPrefitCandidates() { return fEventPrefitCandidates; }
+        Profiler& GetProfiler() { return fProfiler; }
 
         // setters
         void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
@@ -101,6 +137,9 @@ class EventNTagManager
         // check if MC
         void CheckMC();
 
+        // one-time setup of fitters and NN before the first event
+        void InitializeEventLoop();
+
         // ToF subtraction
         void ResetEventHitsVertex();
         //void SetToF(const TVector3& vertex);
@@ -110,7 +149,12 @@ class EventNTagManager
         void SetVertexMode(VertexMode& mode, std::string key);
 
         // delayed vertex fit and max hit search
-        void FindDelayedCandidate(unsigned int iHit);
+        bool PassPrefitCuts(unsigned int iHit);
+        void FindDelayedCandidate(unsigned int iHit, const FitResult* fitResult=nullptr);
+        PMTHitCluster SliceHitsForFit(const PMTHit& firstHit);
+        void FitDelayedVertex(const PMTHitCluster& hitsForFit);
+        void FitInWorkerPool(const std::vector<unsigned int>& peakHitIndices,
+                             std::vector<FitResult>& fitResults, std::vector<bool>& isFitted);
 
         // feature extraction
         void FindFeatures(Candidate& candidate, Float canTime);
@@ -142,6 +186,7 @@ class EventNTagManager
         TaggableCluster fEventTaggables;
         CandidateCluster fEventCandidates;
         CandidateCluster fEventEarlyCandidates;
+        CandidateCluster fEventPrefitCandidates;
         TVector3 fPromptVertex;
 
         // NTag settings
@@ -159,6 +204,10 @@ class EventNTagManager
         VertexFitManager* fDelayedVertexManager;
         TRMSFitManager fTRMSFitManager;
         BonsaiManager fBonsaiManager;
+        LOWFITWorkerPool fLOWFITWorkerPool;
+        FitResultCache fFitResultCache;
+        DeadtimeFilter fDeadtimeFilter;
+        HitReductionPipeline fIDHitReduction, fODHitReduction;
 
         // TMVA
         NTagTMVAManager fTMVAManager;
@@ -174,9 +223,14 @@ class EventNTagManager
 
         // utilities
         Printer fMsg;
+        Profiler fProfiler;
+        AsyncLogSink fEventSummary;
+
+        // input stream
+        StreamContext fStream;
 
         // booleans
-        bool fIsBranchSet, fIsMC, fDoAutoRefRun;
+        bool fIsBranchSet, fIsMC, fIsSynthetic, fDoAutoRefRun, fIsEventLoopInitialized;
         FileFormat fFileFormat;
 };
 
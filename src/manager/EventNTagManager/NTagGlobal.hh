@@ -40,6 +40,10 @@ static std::vector<std::string> gNTagFeatures = {"NHits", "N30", "N50", "N200",
                                                  "fvx", "fvy", "fvz", "DTaggable", "FitGoodness", "DPrompt", "DWall", "DWallMeanDir",
                                                  "SignalRatio", "BurstRatio", "TagOut", "TagIndex", "TagClass", "Label"};
 
+static std::vector<std::string> gPrefitFeatures = {"NHits", "N200", "FitT", "TRMS", "QSum",
+                                                  "NBurst", "BurstRatio", "DarkLikelihood", "NNoisyPMT", "NoisyPMTRatio",
+                                                  "fvx", "fvy", "fvz", "DWall", "DTaggable", "TagIndex", "Label"};
+
 static std::vector<std::string> gTMVAFeatures = {"NHits", "N200", "TRMS",
                                                  "Beta1", "Beta5",
                                                  "OpeningAngleMean", "OpeningAngleSkew", "OpeningAngleStdev",
@@ -52,17 +56,20 @@ static std::vector<std::string> gKerasFeatures = {"NHits", "NResHits", "TRMS",
                                                   "BurstRatio", "FitGoodness", "DarkLikelihood"};
 
 static std::vector<std::string> gCmdOptions = {"force_flat", "outdata", "write_bank", "noise_path", "noise_type", "save_hits",
-                                               "add_noise", "repeat_noise", "in_noise", "dump_noise", "IDDARKRATE", "ODDARKRATE",
-                                               "noise_cut", "PMTDEADTIME", "IDMAXN200", "ODMAXN200", "TGATEMIN", "TGATEMAX",
+                                               "add_noise", "repeat_noise", "in_noise", "noise_library", "dump_noise", "IDDARKRATE", "ODDARKRATE",
+                                               "noise_cut", "binned_n200", "PMTDEADTIME", "IDMAXN200", "ODMAXN200", "TGATEMIN", "TGATEMAX",
                                                "weight", "debug", "in", "out", "NN_type", "correct_tof", "macro",
                                                "prompt_vertex", "delayed_vertex", "vx", "vy", "vz", "tag_e",
-                                               "SKGEOMETRY", "SKOPTN", "SKBADOPT", "REFRUNNO", "lowfit_param",
+                                               "SKGEOMETRY", "SKOPTN", "SKBADOPT", "REFRUNNO", "lowfit_param", "NLOWFITWORKERS", "fit_cache",
                                                "QMAX", "TMIN", "TMAX", "TRBNWIDTH", "PVXRES", "PVXBIAS", "NIDHITMX", "NODHITMX",
-                                               "TNOISESTART", "TNOISEEND", "NOISESEED",
+                                               "TNOISESTART", "TNOISEEND", "NOISESEED", "NOISEPREFETCH", "stateless_noise", "NOISEEVENTOFFSET",
+                                               "synthetic", "pmt_table", "NSYNTHEVENTS", "SYNTHSEED", "SYNTHDARKRATE", "SYNTHNNEUTRONS",
+                                               "SYNTHGDFRACTION", "SYNTHNDECAYE", "SYNTHHITSPERMEV", "SYNTHPROMPTNHITS",
                                                "TWIDTH", "NHITSTH", "NHITSMX", "N200MX", "TCANWIDTH", "MINNHITS", "MAXNHITS",
                                                "TMINPEAKSEP", "TMATCHWINDOW",
                                                "TRMSTWIDTH", "INITGRIDWIDTH", "MINGRIDWIDTH", "GRIDSHRINKRATE", "VTXMAXRADIUS",
-                                               "E_CUTS", "N_CUTS",
-                                               "print", "commit", "tag", "mode"};
+                                               "E_CUTS", "N_CUTS", "PREFIT_CUTS",
+                                               "print", "commit", "tag", "mode", "profile", "perf_json",
+                                               "quiet", "async_log", "event_summary"};
 
 #endif
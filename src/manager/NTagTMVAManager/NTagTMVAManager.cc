@@ -11,9 +11,11 @@
 #include "Calculator.hh"
 #include "NTagGlobal.hh"
 #include "NTagTMVAManager.hh"
+#include "TrainingDataset.hh"
 
 NTagTMVAManager::NTagTMVAManager()
-: fFactory(nullptr), fReader(nullptr), fWeightFilePath(GetENV("NTAGLIBPATH")+"/weights/TMVA_MLP.xml")
+: fFactory(nullptr), fReader(nullptr), fWeightFilePath(GetENV("NTAGLIBPATH")+"/weights/TMVA_MLP.xml"),
+  fTestFraction(0.5), fSplitSeed(0), fNThreads(1)
 {}
 NTagTMVAManager::~NTagTMVAManager()
 {
@@ -114,8 +116,13 @@ void NTagTMVAManager::TrainWeights(const char* inFileName, const char* outFileNa
 
     fFactory->AddSpectator("Label", 'I');
 
-    TChain* chain = new TChain("ntag");
-    chain->Add(inFileName);
+    TrainingDataset dataset;
+    bool isDataset = dataset.Open(inFileName);
+    TChain* chain = nullptr;
+    if (!isDataset) {
+        chain = new TChain("ntag");
+        chain->Add(inFileName);
+    }
 
     //long nAllSig   = chain->Draw("CaptureType", "CaptureType > 0", "goff");
     //long nAllBkg   = chain->Draw("CaptureType", fBkgCut, "goff");
@@ -149,10 +156,40 @@ void NTagTMVAManager::TrainWeights(const char* inFileName, const char* outFileNa
     //    fFactory->PrepareTrainingAndTestTree( "", trainingOption );
     //}
     //else {
-    auto sigCut = Form("(Label==%d||Label==%d)&&SignalRatio>0.2", lnH, lnGd);
-    auto bkgCut = Form("Label==%d&&SignalRatio==0", lNoise);
-    fFactory->SetInputTrees(chain, sigCut, bkgCut);
-    fFactory->PrepareTrainingAndTestTree(sigCut, bkgCut, trainingOption);
+    if (isDataset) {
+        // the dataset is already selected; split it here instead of in TMVA
+        DatasetSplit train, test;
+        dataset.Split(gTMVAFeatures, fTestFraction, fSplitSeed, train, test, fNThreads);
+        fMsg.Print(Form("Dataset %s: %ld training and %ld test candidates",
+                        inFileName, train.nRows, test.nRows));
+
+        // features followed by the Label spectator
+        unsigned int nFeatures = gTMVAFeatures.size();
+        std::vector<double> event(nFeatures + 1);
+        for (auto split: {&train, &test}) {
+            for (long iRow=0; iRow<split->nRows; iRow++) {
+                for (unsigned int iFeature=0; iFeature<nFeatures; iFeature++)
+                    event[iFeature] = split->features[iRow*nFeatures + iFeature];
+                event[nFeatures] = split->labels[iRow];
+                if (split == &train && split->classes[iRow])
+                    fFactory->AddSignalTrainingEvent(event, split->weights[iRow]);
+                else if (split == &train)
+                    fFactory->AddBackgroundTrainingEvent(event, split->weights[iRow]);
+                else if (split->classes[iRow])
+                    fFactory->AddSignalTestEvent(event, split->weights[iRow]);
+                else
+                    fFactory->AddBackgroundTestEvent(event, split->weights[iRow]);
+            }
+        }
+
+        fFactory->PrepareTrainingAndTestTree("", "", "NormMode=None:V:");
+    }
+    else {
+        auto sigCut = Form("(Label==%d||Label==%d)&&SignalRatio>0.2", lnH, lnGd);
+        auto bkgCut = Form("Label==%d&&SignalRatio==0", lNoise);
+        fFactory->SetInputTrees(chain, sigCut, bkgCut);
+        fFactory->PrepareTrainingAndTestTree(sigCut, bkgCut, trainingOption);
+    }
     //if (fUse["Cuts"])
     //    fFactory->BookMethod( TMVA::Types::kCuts, "Cuts",
     //                       "H:V:FitMethod=MC:EffSel:SampleSize=200000:VarProp=FSmart" );
@@ -27,7 +27,17 @@ class NTagTMVAManager
 
         float GetTMVAOutput(const Candidate& candidate);
 
+        /**
+         * @brief Trains TMVA methods on the \c ntag trees in \c inFileName,
+         * or on a TrainingDataset file exported by NTagTrain \c -export.
+         */
         void TrainWeights(const char* inFileName, const char* outFileName, const char* outDirName="new");
+        /**
+         * @brief Sets the test fraction, shuffling seed, and number of loader threads
+         * used to split TrainingDataset inputs in NTagTMVAManager::TrainWeights.
+         */
+        void SetDatasetSplit(float testFraction, unsigned int seed, int nThreads)
+        { fTestFraction = testFraction; fSplitSeed = seed; fNThreads = nThreads; }
         //void ApplyWeights(const char* inFileName, const char* outFileName);
 
     private:
@@ -41,6 +51,10 @@ class NTagTMVAManager
 
         std::map<std::string, bool> fUse;
 
+        float fTestFraction;
+        unsigned int fSplitSeed;
+        int fNThreads;
+
         Printer fMsg;
 };
 
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <TChain.h>
+#include <TChainElement.h>
+
+#include <tqrealroot.h>
+#undef MAXPM
+#undef MAXPMA
+
+#include "Calculator.hh"
+#include "NoiseManager.hh"
+#include "NoiseLibrary.hh"
+
+namespace
+{
+    const char     LIBRARYMAGIC[4] = {'N', 'T', 'N', 'L'};
+    const uint32_t LIBRARYVERSION  = 3;
+
+    int GetMaxN200(const std::vector<NoiseLibraryHit>& sortedHits)
+    {
+        return GetMaxNInWindow(sortedHits.begin(), sortedHits.end(),
+                               [](const NoiseLibraryHit& hit){ return hit.t; }, 200., -500e3, 500e3);
+    }
+
+    int GetBinnedMaxN200(const std::vector<float>& t)
+    {
+        int maxN200 = 0;
+        for (auto const& bin: Histogram(t, 5000, -500e3, 500e3))
+            maxN200 = std::max(maxN200, bin.second);
+        return maxN200;
+    }
+
+    void ReadHits(TQReal* tqreal, std::vector<NoiseLibraryHit>& hits)
+    {
+        hits.clear();
+        unsigned int nRawHits = tqreal->T.size();
+        for (unsigned int j=0; j<nRawHits; j++) {
+            float t = tqreal->T[j];
+            int i = tqreal->cables[j]&0x0000FFFF;
+            // keep only hits with meaningful PMT ID, as in PMTHitCluster::Append
+            bool isValidPMT = (1 <= i && i <= MAXPM) || (20001 <= i && i <= 20000+MAXPMA);
+            if (isValidPMT && -1000e3 < t && t < 1000e3)
+                hits.push_back({t, tqreal->Q[j], i});
+        }
+        std::sort(hits.begin(), hits.end(), [](const NoiseLibraryHit& hit1, const NoiseLibraryHit& hit2) { return hit1.t < hit2.t; });
+    }
+}
+
+NoiseLibrary::NoiseLibrary(Verbosity verbose)
+: fData(nullptr), fSize(0), fHits(nullptr), fEntries(nullptr), fNEntries(0), fMsg("NoiseLibrary", verbose) {}
+
+NoiseLibrary::~NoiseLibrary()
+{
+    Close();
+}
+
+bool NoiseLibrary::Build(TChain* noiseTree, std::string filePath)
+{
+    TQReal* idTQReal = 0; noiseTree->SetBranchAddress("TQREAL", &idTQReal);
+    TQReal* odTQReal = 0; noiseTree->SetBranchAddress("TQAREAL", &odTQReal);
+    Header* header = 0;   noiseTree->SetBranchAddress("HEADER", &header);
+
+    // write to a temporary file first so that an interrupted build does not leave a broken library
+    std::string tmpPath = filePath + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        fMsg.Print(Form("Unable to write noise library to %s!", tmpPath.c_str()), pWARNING);
+        return false;
+    }
+
+    LibraryHeader libHeader;
+    std::memset(&libHeader, 0, sizeof(libHeader));
+    std::memcpy(libHeader.magic, LIBRARYMAGIC, sizeof(LIBRARYMAGIC));
+    libHeader.version   = LIBRARYVERSION;
+    libHeader.hitOffset = sizeof(libHeader);
+    file.write(reinterpret_cast<const char*>(&libHeader), sizeof(libHeader));
+
+    std::vector<NoiseLibraryEntry> entries;
+    std::vector<NoiseLibraryHit> idHits, odHits;
+
+    long nTreeEntries = noiseTree->GetEntries();
+    for (long iEntry=0; iEntry<nTreeEntries; iEntry++) {
+        noiseTree->GetEntry(iEntry);
+
+        int trgType = header->idtgsk;
+        if (!(trgType & mRandomWide || trgType == mT2KDummy || trgType & mNickel))
+            continue;
+
+        ReadHits(idTQReal, idHits);
+        ReadHits(odTQReal, odHits);
+        if (idHits.empty() || odHits.empty()) {
+            fMsg.Print(Form("Skipping an empty noise event at entry %ld...", iEntry), pDEBUG);
+            continue;
+        }
+
+        NoiseLibraryEntry entry;
+        entry.run         = header->nrunsk;
+        entry.subrun      = header->nsubsk;
+        entry.event       = header->nevsk;
+        entry.trigger     = trgType;
+        entry.iFile       = noiseTree->GetTreeNumber();
+        entry.tMin        = std::max(idHits.front().t, odHits.front().t);
+        entry.tMax        = std::min(idHits.back().t, odHits.back().t);
+        entry.idMaxN200   = GetMaxN200(idHits);
+        entry.odMaxN200   = GetMaxN200(odHits);
+        entry.idMaxN200Binned = GetBinnedMaxN200(idTQReal->T);
+        entry.odMaxN200Binned = GetBinnedMaxN200(odTQReal->T);
+        entry.nIDHits     = idHits.size();
+        entry.nODHits     = odHits.size();
+        entry.idHitOffset = libHeader.nHits;
+        entry.odHitOffset = libHeader.nHits + idHits.size();
+        entries.push_back(entry);
+
+        file.write(reinterpret_cast<const char*>(idHits.data()), idHits.size()*sizeof(NoiseLibraryHit));
+        file.write(reinterpret_cast<const char*>(odHits.data()), odHits.size()*sizeof(NoiseLibraryHit));
+        libHeader.nHits += idHits.size() + odHits.size();
+
+        fMsg.Print(Form("Processed noise entry %ld/%ld...\x1b[A\r", iEntry+1, nTreeEntries), pDEBUG);
+    }
+
+    // align the index to 8 bytes for mapping
+    libHeader.indexOffset = libHeader.hitOffset + libHeader.nHits*sizeof(NoiseLibraryHit);
+    unsigned int nPadding = (8 - libHeader.indexOffset % 8) % 8;
+    const char padding[8] = {0};
+    file.write(padding, nPadding);
+    libHeader.indexOffset += nPadding;
+
+    libHeader.nEntries = entries.size();
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size()*sizeof(NoiseLibraryEntry));
+
+    // file table
+    libHeader.fileTableOffset = libHeader.indexOffset + entries.size()*sizeof(NoiseLibraryEntry);
+    TObjArray* fileList = noiseTree->GetListOfFiles();
+    libHeader.nFiles = fileList->GetEntries();
+    for (unsigned int iFile=0; iFile<libHeader.nFiles; iFile++) {
+        const char* noiseFilePath = ((TChainElement*)fileList->At(iFile))->GetTitle();
+        file.write(noiseFilePath, std::strlen(noiseFilePath)+1);
+    }
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&libHeader), sizeof(libHeader));
+    file.close();
+
+    noiseTree->ResetBranchAddresses();
+
+    if (!file || std::rename(tmpPath.c_str(), filePath.c_str())) {
+        fMsg.Print(Form("Unable to write noise library to %s!", filePath.c_str()), pWARNING);
+        return false;
+    }
+
+    fMsg.Print(Form("Wrote %lu noise events (%lu hits) from %lu files to %s",
+                    (unsigned long)libHeader.nEntries, (unsigned long)libHeader.nHits,
+                    (unsigned long)libHeader.nFiles, filePath.c_str()));
+    return true;
+}
+
+bool NoiseLibrary::Open(std::string filePath)
+{
+    Close();
+
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fMsg.Print(Form("Unable to open noise library %s!", filePath.c_str()), pWARNING);
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) || (size_t)fileStat.st_size < sizeof(LibraryHeader)) {
+        fMsg.Print(Form("%s is not a valid noise library!", filePath.c_str()), pWARNING);
+        close(fd);
+        return false;
+    }
+
+    fSize = fileStat.st_size;
+    fData = mmap(nullptr, fSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (fData == MAP_FAILED) {
+        fMsg.Print(Form("Unable to map noise library %s into memory!", filePath.c_str()), pWARNING);
+        fData = nullptr; fSize = 0;
+        return false;
+    }
+
+    auto base = static_cast<const char*>(fData);
+    auto libHeader = reinterpret_cast<const LibraryHeader*>(base);
+
+    if (std::string(libHeader->magic, 4) == std::string(LIBRARYMAGIC, 4) && libHeader->version != LIBRARYVERSION) {
+        fMsg.Print(Form("Noise library %s has version %u, but version %u is required. Please rebuild it with MakeNoiseLibrary.",
+                        filePath.c_str(), libHeader->version, LIBRARYVERSION), pWARNING);
+        Close();
+        return false;
+    }
+
+    bool isValid = std::string(libHeader->magic, 4) == std::string(LIBRARYMAGIC, 4)
+                   && libHeader->hitOffset + libHeader->nHits*sizeof(NoiseLibraryHit) <= libHeader->indexOffset
+                   && libHeader->indexOffset + libHeader->nEntries*sizeof(NoiseLibraryEntry) <= libHeader->fileTableOffset
+                   && libHeader->fileTableOffset <= fSize;
+    if (!isValid) {
+        fMsg.Print(Form("%s is not a valid noise library!", filePath.c_str()), pWARNING);
+        Close();
+        return false;
+    }
+
+    fHits     = reinterpret_cast<const NoiseLibraryHit*>(base + libHeader->hitOffset);
+    fEntries  = reinterpret_cast<const NoiseLibraryEntry*>(base + libHeader->indexOffset);
+    fNEntries = libHeader->nEntries;
+
+    const char* filePathBegin = base + libHeader->fileTableOffset;
+    const char* fileEnd = base + fSize;
+    for (uint64_t iFile=0; iFile<libHeader->nFiles && filePathBegin<fileEnd; iFile++) {
+        const char* filePathEnd = std::find(filePathBegin, fileEnd, '\0');
+        fFilePaths.emplace_back(filePathBegin, filePathEnd);
+        filePathBegin = filePathEnd + 1;
+    }
+
+    // noise events are read consecutively
+    madvise(fData, fSize, MADV_SEQUENTIAL);
+
+    fPath = filePath;
+    fMsg.Print(Form("Mapped %lu noise events from %lu files in %s",
+                    (unsigned long)fNEntries, (unsigned long)fFilePaths.size(), fPath.c_str()));
+    return true;
+}
+
+void NoiseLibrary::Close()
+{
+    if (fData) munmap(fData, fSize);
+
+    fData = nullptr; fSize = 0;
+    fHits = nullptr; fEntries = nullptr; fNEntries = 0;
+    fFilePaths.clear();
+    fPath.clear();
+}
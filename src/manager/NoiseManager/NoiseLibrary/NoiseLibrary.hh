@@ -0,0 +1,102 @@
+/**
+ * @file NoiseLibrary.hh
+ */
+
+#ifndef NOISELIBRARY_HH
+#define NOISELIBRARY_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Printer.hh"
+
+class TChain;
+
+/**
+ * @brief A dummy trigger hit packed in NoiseLibrary.
+ */
+typedef struct NoiseLibraryHit {
+    float   t, q;
+    int32_t i;
+} NoiseLibraryHit;
+
+/**
+ * @brief Index record of a dummy trigger event in NoiseLibrary.
+ */
+typedef struct NoiseLibraryEntry {
+    int32_t  run, subrun, event, trigger;
+    uint32_t iFile;                    ///< index of the source file in the file table
+    float    tMin, tMax;               ///< time range covered by both ID and OD hits (ns)
+    int32_t  idMaxN200, odMaxN200;     ///< maximum ID/OD N200 in [-500, 500] usec
+    int32_t  idMaxN200Binned, odMaxN200Binned; ///< same as above, in fixed 200 ns bins (binned_n200)
+    uint32_t nIDHits, nODHits;
+    uint64_t idHitOffset, odHitOffset; ///< position of the first ID/OD hit in the hit array
+} NoiseLibraryEntry;
+
+/**
+ * @brief Memory-mapped library of dummy trigger hits for NoiseManager.
+ *
+ * @details NoiseLibrary::Build reads a chain of dummy trigger files once
+ * and writes the hits of accepted random-wide, T2K dummy, and nickel trigger events
+ * into a single binary file, together with an index of the events.
+ * Hits are sorted in time within each event and detector (ID/OD).
+ * NoiseLibrary::Open maps the file into memory, so that noise segments
+ * can be read without opening the dummy trigger files through a TChain.
+ *
+ * The file consists of a header, the hit array, the entry index,
+ * and a table of null-terminated source file paths, in this order.
+ */
+class NoiseLibrary
+{
+    public:
+        NoiseLibrary(Verbosity verbose=pDEFAULT);
+        ~NoiseLibrary();
+
+        /**
+         * @brief Extracts dummy trigger hits from \c noiseTree and writes a library file to \c filePath.
+         * @return \c true if the library file is written successfully.
+         */
+        bool Build(TChain* noiseTree, std::string filePath);
+
+        /**
+         * @brief Maps the library file at \c filePath into memory.
+         * @return \c true if the file is a valid noise library.
+         */
+        bool Open(std::string filePath);
+        void Close();
+        bool IsOpen() const { return fData != nullptr; }
+
+        uint64_t GetNEntries() const { return fNEntries; }
+        const NoiseLibraryEntry& GetEntry(uint64_t iEntry) const { return fEntries[iEntry]; }
+        const NoiseLibraryHit* GetHits(const NoiseLibraryEntry& entry, bool OD=false) const
+        { return fHits + (OD ? entry.odHitOffset : entry.idHitOffset); }
+        unsigned int GetNHits(const NoiseLibraryEntry& entry, bool OD=false) const
+        { return OD ? entry.nODHits : entry.nIDHits; }
+        std::string GetFilePath(unsigned int iFile) const { return iFile < fFilePaths.size() ? fFilePaths[iFile] : ""; }
+        const std::string& GetPath() const { return fPath; }
+
+        void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
+
+    private:
+        typedef struct LibraryHeader {
+            char     magic[4];
+            uint32_t version;
+            uint64_t nEntries, nHits, nFiles;
+            uint64_t hitOffset, indexOffset, fileTableOffset; ///< byte offsets from the beginning of the file
+        } LibraryHeader;
+
+        std::string fPath;
+
+        void*  fData;
+        size_t fSize;
+
+        const NoiseLibraryHit*   fHits;
+        const NoiseLibraryEntry* fEntries;
+        uint64_t fNEntries;
+        std::vector<std::string> fFilePaths;
+
+        Printer fMsg;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <fstream>
+#include <queue>
 
 #include <TROOT.h>
 #include <TF1.h>
@@ -36,9 +37,12 @@ NoiseManager::NoiseManager()
   fPMTDeadtime(900), fIDDarkRatekHz(7.5), fODDarkRatekHz(4.0),
   fCurrentIDHitIndex(0), fCurrentODHitIndex(0),
   fCurrentEntry(-1), fNEntries(0),
+  fCurrentRun(0), fCurrentSubrun(0), fCurrentEventID(0),
   fPartID(0), fNParts(2),
   fCurrentPartStartTime(-1000e3), fCurrentPartEndTime(1000e3),
-  fDoRepeat(true), fDoN200Cut(false),
+  fDoRepeat(true), fDoN200Cut(false), fUseBinnedN200(false),
+  fNoiseLibraryOffset(0),
+  fIsStateless(false), fNoiseEventOffset(0), fInputEventIndex(0), fScheduledEventIndex(-1),
   fMsg("NoiseManager")
 {}
 
@@ -50,6 +54,7 @@ NoiseManager::NoiseManager(TChain* tree)
 
 NoiseManager::~NoiseManager()
 {
+    fNoisePrefetcher.Stop();
     if (fNoiseTree) delete fNoiseTree;
 }
 
@@ -65,11 +70,19 @@ void NoiseManager::DumpSettings()
 {
     fMsg.PrintBlock("NoiseManager settings");
 
-    if (fNoiseTree) {
+    if (fNoiseLibrary.IsOpen()) {
+        fMsg.Print(Form("Noise library: %s", fNoiseLibrary.GetPath().c_str()));
+        fMsg.Print(Form("Total dummy trigger entries: %d", fNEntries));
+        fMsg.Print(Form("Repetition allowed? %s", (fDoRepeat ? "yes" : "no")));
+        if (fDoN200Cut) fMsg.Print(Form("Noise MaxN200: %d (ID), %d (OD)%s", fIDMaxN200, fODMaxN200,
+                                        (fUseBinnedN200 ? " in fixed bins" : "")));
+    }
+    else if (fNoiseTree) {
         fMsg.Print(Form("Noise type: " + fNoiseType));
         fMsg.Print(Form("Total dummy trigger entries: %d", fNoiseTree->GetEntries(fNoiseCut)));
         fMsg.Print(Form("Repetition allowed? %s", (fDoRepeat ? "yes" : "no")));
-        if (fDoN200Cut) fMsg.Print(Form("Noise MaxN200: %d (ID), %d (OD)", fIDMaxN200, fODMaxN200));
+        if (fDoN200Cut) fMsg.Print(Form("Noise MaxN200: %d (ID), %d (OD)%s", fIDMaxN200, fODMaxN200,
+                                        (fUseBinnedN200 ? " in fixed bins" : "")));
     }
     else {
         fMsg.Print(Form("ID dark rate: %3.2f kHz", fIDDarkRatekHz));
@@ -77,14 +90,14 @@ void NoiseManager::DumpSettings()
     }
     fMsg.Print(Form("Noise range: [%3.2f, %3.2f] usec (T_trigger=0)", fNoiseStartTime*1e-3-1, fNoiseEndTime*1e-3-1));
     fMsg.Print(Form("Seed: %d", fNoiseSeed));
+    if (fIsStateless) fMsg.Print(Form("Stateless noise assignment: %lu noise segments, event index offset %ld",
+                                      (unsigned long)fNoiseScheduler.GetNSegments(), fNoiseEventOffset));
     fMsg.Print(Form("PMT deadtime: %3.2f ns", fPMTDeadtime));
     std::cout << "\n";
 }
 
 void NoiseManager::AddNoiseFileToChain(TChain* chain, TString noiseFilePath)
 {
-    static std::vector<TString> usedFilesList;
-
     TFile* dummyFile = 0;
     TTree* tree = 0;
     int nAddedEntries = 0;
@@ -97,11 +110,11 @@ void NoiseManager::AddNoiseFileToChain(TChain* chain, TString noiseFilePath)
         dummyFile->Close();
     }
 
-    if (nAddedEntries && FindIndex(usedFilesList, noiseFilePath)<0) {
+    if (nAddedEntries && FindIndex(fUsedNoiseFiles, noiseFilePath)<0) {
         fMsg.Print(Form("Adding dummy file at ") + noiseFilePath + Form(": %d entries", nAddedEntries));
         chain->Add(noiseFilePath);
         fNEntries += nAddedEntries;
-        usedFilesList.push_back(noiseFilePath);
+        fUsedNoiseFiles.push_back(noiseFilePath);
     }
 }
 
@@ -126,6 +139,7 @@ void NoiseManager::DumpNoiseFileList(TString pathToList)
     outFile << "TNOISEEND "   << (fNoiseEndTime-1000)*1e-3 << "\n";
     outFile << "PMTDEADTIME " << fPMTDeadtime << "\n";
     outFile << "noise_cut "   << fDoN200Cut << "\n";
+    outFile << "binned_n200 " << fUseBinnedN200 << "\n";
     outFile << "IDMAXN200 "   << fIDMaxN200 << "\n";
     outFile << "ODMAXN200 "   << fODMaxN200 << "\n";
     outFile << "\n";
@@ -225,6 +239,7 @@ void NoiseManager::SetNoiseTreeFromList(TString pathToList)
         if (option=="TNOISEEND")     endTime      = value;
         if (option=="PMTDEADTIME")   fPMTDeadtime = value;
         if (option=="noise_cut")     fDoN200Cut   = value;
+        if (option=="binned_n200")   fUseBinnedN200 = value;
         if (option=="IDMAXN200")     fIDMaxN200   = value;
         if (option=="ODMAXN200")     fODMaxN200   = value;
     }
@@ -254,6 +269,62 @@ void NoiseManager::SetNoiseTreeFromWildcard(TString wildcard, float tStart, floa
     SetNoiseTree(dummyChain);
 }
 
+void NoiseManager::SetNoiseLibrary(TString pathToLibrary, float tStart, float tEnd)
+{
+    SetNoiseTimeRange(tStart, tEnd);
+
+    if (!fNoiseLibrary.Open(pathToLibrary.Data()) || !fNoiseLibrary.GetNEntries())
+        fMsg.Print("Empty or invalid noise library " + pathToLibrary + "! Aborting...", pERROR);
+
+    fNoiseType = "library";
+    fNEntries = fNoiseLibrary.GetNEntries();
+
+    // start from a random event, since the library is not a random pick of noise files
+    fNoiseLibraryOffset = ranGen.Integer(fNEntries);
+}
+
+void NoiseManager::SetStatelessNoise(long eventOffset)
+{
+    fIsStateless = true;
+    fNoiseEventOffset = eventOffset;
+    fScheduledEventIndex = -1;
+
+    // simulated noise only needs the seed
+    if (!fNoiseTree && !fNoiseLibrary.IsOpen()) return;
+
+    fNoiseScheduler.Clear();
+    fNoiseScheduler.SetSeed(fNoiseSeed);
+    fNoiseScheduler.SetWindowWidth(fNoiseWindowWidth);
+
+    if (fNoiseLibrary.IsOpen()) {
+        fNoiseLibraryOffset = 0;
+        for (int iEntry=0; iEntry<fNEntries; iEntry++) {
+            auto const& entry = fNoiseLibrary.GetEntry(iEntry);
+            int idMaxN200 = fUseBinnedN200 ? entry.idMaxN200Binned : entry.idMaxN200;
+            int odMaxN200 = fUseBinnedN200 ? entry.odMaxN200Binned : entry.odMaxN200;
+            if (!fDoN200Cut || (odMaxN200 <= fODMaxN200 && idMaxN200 <= fIDMaxN200))
+                fNoiseScheduler.AddNoiseEvent(iEntry, entry.tMin, entry.tMax);
+        }
+    }
+    else {
+        // noise event lengths are only known after reading all hits
+        fMsg.Print(Form("Reading %d noise entries to schedule noise segments...", fNEntries));
+        PMTHitCluster idHits, odHits;
+        for (fCurrentEntry=0; fCurrentEntry<fNEntries; fCurrentEntry++) {
+            idHits.Clear(); odHits.Clear();
+            if (ReadNoiseEntry(&idHits, &odHits)) {
+                float minT = std::max(idHits.First().t(), odHits.First().t());
+                float maxT = std::min(idHits.Last().t(), odHits.Last().t());
+                fNoiseScheduler.AddNoiseEvent(fCurrentEntry, minT, maxT);
+            }
+        }
+        fCurrentEntry = -1;
+    }
+
+    if (!fNoiseScheduler.IsReady())
+        fMsg.Print("No noise event is long enough for the noise window! Aborting...", pERROR);
+}
+
 void NoiseManager::ApplySettings(Store& settings, int nInputEvents)
 {
     auto skGen       = SKIO::GetSKGeometry();
@@ -263,11 +334,16 @@ void NoiseManager::ApplySettings(Store& settings, int nInputEvents)
     auto doN200Cut   = settings.GetBool("noise_cut", false);
     auto idMaxN200   = settings.GetInt("IDMAXN200", 60);
     auto odMaxN200   = settings.GetInt("ODMAXN200", 20);
+    auto binnedN200  = settings.GetBool("binned_n200", false);
     auto inputNoise  = settings.GetString("in_noise");
+    auto noiseLib    = settings.GetString("noise_library");
     auto noiseList   = settings.GetString("dump_noise");
     auto tNoiseStart = settings.GetFloat("TNOISESTART", 0);
     auto tNoiseEnd   = settings.GetFloat("TNOISEEND", 535);
     auto noiseSeed   = settings.GetInt("NOISESEED");
+    auto nPrefetch   = settings.GetInt("NOISEPREFETCH", 0);
+    auto isStateless = settings.GetBool("stateless_noise", false);
+    auto eventOffset = settings.GetInt("NOISEEVENTOFFSET", 0);
     //auto pmtDeadtime = settings.GetFloat("PMTDEADTIME", 900);
     float pmtDeadtime = 900;
     auto debug       = settings.GetBool("debug", false);
@@ -275,13 +351,17 @@ void NoiseManager::ApplySettings(Store& settings, int nInputEvents)
     SetSKGeneration(skGen);
     SetSeed(noiseSeed);
     SetNoiseMaxN200(idMaxN200, odMaxN200, doN200Cut);
+    SetBinnedN200(binnedN200);
     SetPMTDeadtime(pmtDeadtime);
     if (debug) SetVerbosity(pDEBUG);
     if (noiseType == "simulate") {
         SetDarkRate(idDarkRate, odDarkRate);
     }
     else {
-        if (!inputNoise.empty()) {
+        if (!noiseLib.empty()) {
+            SetNoiseLibrary(noiseLib, tNoiseStart, tNoiseEnd);
+        }
+        else if (!inputNoise.empty()) {
             if (TString(inputNoise).EndsWith(".root"))
                 SetNoiseTreeFromWildcard(inputNoise, tNoiseStart, tNoiseEnd);
             else
@@ -290,101 +370,242 @@ void NoiseManager::ApplySettings(Store& settings, int nInputEvents)
         else {
             SetNoisePath(settings.GetString("noise_path"));
             SetNoiseTreeFromOptions(noiseType, nInputEvents, tNoiseStart, tNoiseEnd, noiseSeed);
+            if (isStateless)
+                fMsg.Print("Noise files picked with noise_type depend on the number of input events. "
+                           "Use in_noise or noise_library to reproduce noise across split jobs.", pWARNING);
         }
-        if (!noiseList.empty())
+        if (!noiseList.empty() && fNoiseTree)
             DumpNoiseFileList(noiseList);
 
         SetRepeat(settings.GetBool("repeat_noise", true));
     }
 
+    if (isStateless)
+        SetStatelessNoise(eventOffset);
+
     DumpSettings();
+
+    // the noise library is already read without ROOT I/O,
+    // and stateless noise is read out of order
+    if (fNoiseTree && !fNoiseLibrary.IsOpen() && !fIsStateless && nPrefetch > 0) {
+        fNoisePrefetcher.Start(nPrefetch, this);
+        ReopenNoiseTree();
+    }
+}
+
+void NoiseManager::ReopenNoiseTree()
+{
+    // the noise reader shares the file offsets of the noise files opened before the fork,
+    // so the entries too large to be prefetched are read from separately opened files
+    TChain* tree = new TChain(fNoiseTreeName);
+    TObjArray* fileList = fNoiseTree->GetListOfFiles();
+    for (int iFile=0; iFile<fileList->GetEntries(); iFile++)
+        tree->Add(((TChainElement*)fileList->At(iFile))->GetTitle());
+
+    // closes only the descriptors of this process
+    delete fNoiseTree;
+    SetNoiseTree(tree);
 }
 
 void NoiseManager::GetNextNoiseEvent()
 {
     fPartID = 0; fCurrentIDHitIndex = 0; fCurrentODHitIndex = 0;
+    fIDNoiseEventHits.Clear(); fODNoiseEventHits.Clear();
 
-    fCurrentEntry++; fIDNoiseEventHits.Clear(); fODNoiseEventHits.Clear();
-    if (fCurrentEntry < fNEntries) {
-        fNoiseTree->GetEntry(fCurrentEntry);
-        int trgType = fHeader->idtgsk;
-        if (trgType & mRandomWide || trgType == mT2KDummy || trgType & mNickel)
-            SetNoiseEventHits();
-        else
-            GetNextNoiseEvent();
+    bool hasNoiseEvent = false;
+    float minT = 0, maxT = 0;
+
+    if (fNoiseLibrary.IsOpen()) {
+        hasNoiseEvent = ReadNextLibraryEvent();
+        if (hasNoiseEvent) {
+            auto const& entry = fNoiseLibrary.GetEntry((fNoiseLibraryOffset + fCurrentEntry) % fNEntries);
+            minT = entry.tMin; maxT = entry.tMax;
+        }
     }
     else {
-        fMsg.Print("Noise tree reached its end!", pWARNING);
-        if (fCurrentEntry == fNEntries && fDoRepeat) {
-            // start from beginning
-            fMsg.Print("Repetition allowed: going back to the first entry in noise tree...", pWARNING);
-            fCurrentEntry = -1;
-            GetNextNoiseEvent();
-            //fNoiseTree->GetEntry(fCurrentEntry);
+        if (fNoisePrefetcher.IsRunning()) {
+            bool isOversize = false;
+            hasNoiseEvent = fNoisePrefetcher.Pop(&fIDNoiseEventHits, &fODNoiseEventHits,
+                                                 fCurrentEntry, fCurrentRun, fCurrentSubrun, fCurrentEventID, isOversize);
+            // too large to be prefetched: read the same entry here
+            if (hasNoiseEvent && isOversize)
+                ReadNoiseEntry(&fIDNoiseEventHits, &fODNoiseEventHits);
+        }
+        else
+            hasNoiseEvent = ReadNextNoiseEvent(&fIDNoiseEventHits, &fODNoiseEventHits);
+
+        if (hasNoiseEvent) {
+            float idMinT = fIDNoiseEventHits.First().t(); float idMaxT = fIDNoiseEventHits.Last().t();
+            float odMinT = fODNoiseEventHits.First().t(); float odMaxT = fODNoiseEventHits.Last().t();
+            minT = idMinT>odMinT ? idMinT : odMinT;
+            maxT = idMaxT<odMaxT ? idMaxT : odMaxT;
+        }
+    }
+
+    if (!hasNoiseEvent)
+        fMsg.Print("Repetition disallowed. To allow, use NoiseManager::SetRepeat(true). Aborting program...", pERROR);
+
+    SetNoiseEventTimeRange(minT, maxT);
+}
+
+void NoiseManager::UseScheduledSegment()
+{
+    long eventIndex = fNoiseEventOffset + fInputEventIndex;
+    if (eventIndex == fScheduledEventIndex) return;
+
+    auto segment = fNoiseScheduler.GetSegment(eventIndex);
+    if (segment.pass && !fDoRepeat)
+        fMsg.Print("All noise segments are used and repetition disallowed. "
+                   "To allow, use NoiseManager::SetRepeat(true). Aborting program...", pERROR);
+
+    if (segment.entry != fCurrentEntry) {
+        fCurrentEntry = segment.entry;
+        if (fNoiseLibrary.IsOpen()) {
+            auto const& entry = fNoiseLibrary.GetEntry(fCurrentEntry);
+            fCurrentRun = entry.run; fCurrentSubrun = entry.subrun; fCurrentEventID = entry.event;
         }
         else {
-            // error
-            fMsg.Print("Repetition disallowed. To allow, use NoiseManager::SetRepeat(true). Aborting program...", pERROR);
+            fIDNoiseEventHits.Clear(); fODNoiseEventHits.Clear();
+            ReadNoiseEntry(&fIDNoiseEventHits, &fODNoiseEventHits);
         }
     }
+
+    fPartID = segment.part; fNParts = segment.nParts; fNoiseT0 = segment.t0;
+    fCurrentIDHitIndex = 0; fCurrentODHitIndex = 0;
+    fScheduledEventIndex = eventIndex;
 }
 
-void NoiseManager::SetNoiseEventHits()
+bool NoiseManager::GoToNextEntry()
 {
-    bool useThisNoiseEvent = true;
+    fCurrentEntry++;
 
-    if (fDoN200Cut) {
-        // dark selection: OD max N200 <= 20 && ID max N200 <= 50
-        auto idHist = Histogram(fIDTQReal->T, 5000, -500e3, 500e3);
-        auto odHist = Histogram(fODTQReal->T, 5000, -500e3, 500e3);
-        for (int iBin=0; iBin<5000; iBin++) {
-            if (odHist[iBin].second > fODMaxN200 | idHist[iBin].second > fIDMaxN200) {
-                fMsg.Print(Form("Rejecting noise event with OD N200 %d and ID N200 %d...",
-                                 odHist[iBin].second, idHist[iBin].second), pWARNING);
-                useThisNoiseEvent = false; break;
-            }
-        }
+    if (fCurrentEntry >= fNEntries) {
+        fMsg.Print("Noise tree reached its end!", pWARNING);
+        if (!fDoRepeat)
+            return false;
+
+        // start from beginning
+        fMsg.Print("Repetition allowed: going back to the first entry in noise tree...", pWARNING);
+        fCurrentEntry = 0;
     }
 
+    return true;
+}
+
+bool NoiseManager::ReadNextNoiseEvent(PMTHitCluster* idHits, PMTHitCluster* odHits)
+{
+    while (GoToNextEntry()) {
+        idHits->Clear(); odHits->Clear();
+        if (ReadNoiseEntry(idHits, odHits))
+            return true;
+    }
+
+    return false;
+}
+
+bool NoiseManager::ReadNoiseEntry(PMTHitCluster* idHits, PMTHitCluster* odHits)
+{
+    fNoiseTree->GetEntry(fCurrentEntry);
+    fCurrentRun = fHeader->nrunsk; fCurrentSubrun = fHeader->nsubsk; fCurrentEventID = fHeader->nevsk;
+
+    int trgType = fHeader->idtgsk;
+    if (!(trgType & mRandomWide || trgType == mT2KDummy || trgType & mNickel))
+        return false;
+
     // make sure noise event is not empty
     if (!fIDTQReal->nhits || !fODTQReal->nhits) {
         fMsg.Print(Form("Skipping an empty noise event..."), pWARNING);
-        useThisNoiseEvent = false;
+        return false;
     }
 
     // populate hit clusters
-    if (useThisNoiseEvent) {
-        PopulateHitCluster(&fIDNoiseEventHits);
-        PopulateHitCluster(&fODNoiseEventHits, true);
-
-        int nHits = fIDNoiseEventHits.GetSize();
-        float idMinT = fIDNoiseEventHits.First().t(); float idMaxT = fIDNoiseEventHits.Last().t();
-        float odMinT = fODNoiseEventHits.First().t(); float odMaxT = fODNoiseEventHits.Last().t();
-        float minT = idMinT>odMinT ? idMinT : odMinT;
-        float maxT = idMaxT<odMaxT ? idMaxT : odMaxT;
-        fNoiseEventMinT = minT; fNoiseEventMaxT = maxT;
-
-        fNoiseEventLength = maxT - minT;
-        fNParts = (int)(fNoiseEventLength / fNoiseWindowWidth);
-        auto random = ranGen.Uniform();
-        fNoiseT0 = minT + (fNoiseEventLength - fNParts*fNoiseWindowWidth)*random;
-
-        if (fNoiseEventLength < fNoiseWindowWidth) {
-            fMsg.Print(Form("Noise event length %3.2f us is smaller than required window width %3.2f us, "
-                            "getting next noise event...",
-                            fNoiseEventLength*1e-3, fNoiseWindowWidth*1e-3), pWARNING);
-            GetNextNoiseEvent();
+    PopulateHitCluster(idHits);
+    PopulateHitCluster(odHits, true);
+
+    if (fDoN200Cut) {
+        // dark selection: OD max N200 <= ODMAXN200 && ID max N200 <= IDMAXN200
+        int idMaxN200 = 0, odMaxN200 = 0;
+        if (fUseBinnedN200) {
+            for (auto const& bin: Histogram(fIDTQReal->T, 5000, -500e3, 500e3))
+                idMaxN200 = std::max(idMaxN200, bin.second);
+            for (auto const& bin: Histogram(fODTQReal->T, 5000, -500e3, 500e3))
+                odMaxN200 = std::max(odMaxN200, bin.second);
+        }
+        else {
+            auto getT = [](const PMTHit& hit){ return hit.t(); };
+            idMaxN200 = GetMaxNInWindow(idHits->begin(), idHits->end(), getT, 200., -500e3, 500e3);
+            odMaxN200 = GetMaxNInWindow(odHits->begin(), odHits->end(), getT, 200., -500e3, 500e3);
+        }
+
+        if (IsBurstyNoiseEvent(idMaxN200, odMaxN200)) {
+            idHits->Clear(); odHits->Clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool NoiseManager::IsBurstyNoiseEvent(int idMaxN200, int odMaxN200)
+{
+    if (odMaxN200 > fODMaxN200 || idMaxN200 > fIDMaxN200) {
+        fMsg.Print(Form("Rejecting noise event with OD N200 %d and ID N200 %d...",
+                         odMaxN200, idMaxN200), pWARNING);
+        return true;
+    }
+    return false;
+}
+
+bool NoiseManager::ReadNextLibraryEvent()
+{
+    while (GoToNextEntry()) {
+        auto const& entry = fNoiseLibrary.GetEntry((fNoiseLibraryOffset + fCurrentEntry) % fNEntries);
+        fCurrentRun = entry.run; fCurrentSubrun = entry.subrun; fCurrentEventID = entry.event;
+
+        // dark selection with the N200 precomputed in the library
+        if (fDoN200Cut) {
+            if (fUseBinnedN200 ? IsBurstyNoiseEvent(entry.idMaxN200Binned, entry.odMaxN200Binned)
+                               : IsBurstyNoiseEvent(entry.idMaxN200, entry.odMaxN200))
+                continue;
         }
+
+        return true;
     }
 
-    else GetNextNoiseEvent();
+    return false;
+}
+
+void NoiseManager::SetNoiseEventTimeRange(float minT, float maxT)
+{
+    fNoiseEventMinT = minT; fNoiseEventMaxT = maxT;
+
+    fNoiseEventLength = maxT - minT;
+    fNParts = (int)(fNoiseEventLength / fNoiseWindowWidth);
+    auto random = ranGen.Uniform();
+    fNoiseT0 = minT + (fNoiseEventLength - fNParts*fNoiseWindowWidth)*random;
+
+    if (fNoiseEventLength < fNoiseWindowWidth) {
+        fMsg.Print(Form("Noise event length %3.2f us is smaller than required window width %3.2f us, "
+                        "getting next noise event...",
+                        fNoiseEventLength*1e-3, fNoiseWindowWidth*1e-3), pWARNING);
+        GetNextNoiseEvent();
+    }
 }
 
 void NoiseManager::AddNoise(PMTHitCluster* signalHits, PMTHitCluster* noiseHits, int& currentHitIndex, float darkRate, bool OD)
 {
+    bool isSimulated = !fNoiseTree && !fNoiseLibrary.IsOpen();
+    HitReductionResult res;
+
+    // in case fNoiseTree is empty, simulate noise
+    if (isSimulated)
+        res = AddSimulatedNoise(signalHits, darkRate, OD);
+
     // noise from noise files
-    if (fNoiseTree) {
-        if (fCurrentEntry == -1 || fPartID == fNParts) {
+    else {
+        if (fIsStateless)
+            UseScheduledSegment();
+        else if (fCurrentEntry == -1 || fPartID == fNParts) {
             GetNextNoiseEvent();
         }
         //std::cout << "NoiseHitsSize: " << noiseHits->GetSize() << "\n";
@@ -393,69 +614,162 @@ void NoiseManager::AddNoise(PMTHitCluster* signalHits, PMTHitCluster* noiseHits,
         float partStartTime = fNoiseT0 + fPartID * fNoiseWindowWidth;
         float partEndTime = partStartTime + fNoiseWindowWidth;
         fCurrentPartStartTime = partStartTime; fCurrentPartEndTime = partEndTime;
-        unsigned long nAvailableHits = noiseHits->GetSize();
+        int nAvailableHits = noiseHits->GetSize();
 
         fMsg.Print(Form("Processing %s", (OD?"OD":"ID")), pDEBUG);
         fMsg.Print(Form("Current noise entry: %d, part %d/%d", fCurrentEntry, fPartID+1, fNParts), pDEBUG);
         fMsg.Print(Form("Noise event range: [%3.2f, %3.2f] usec, part %d/%d time range: [%3.2f, %3.2f] usec",
                         fNoiseEventMinT*1e-3, fNoiseEventMaxT*1e-3, fPartID+1, fNParts, partStartTime*1e-3, partEndTime*1e-3), pDEBUG);
-        while (noiseHits->At(currentHitIndex).t() < partStartTime) {
-            currentHitIndex++;
+        if (fNoiseLibrary.IsOpen()) {
+            res = AddLibraryNoise(signalHits, partStartTime, partEndTime, OD);
         }
+        else {
+            while (currentHitIndex < nAvailableHits && noiseHits->At(currentHitIndex).t() < partStartTime) {
+                currentHitIndex++;
+            }
 
-        while (noiseHits->At(currentHitIndex).t() < partEndTime) {
-            PMTHit hit = noiseHits->At(currentHitIndex);
-            hit += (fNoiseStartTime - partStartTime);
-            signalHits->Append(hit);
-            currentHitIndex++;
+            Float tOffset = fNoiseStartTime - partStartTime;
+            res = MergeNoiseHits(signalHits, [&](PMTHit& hit) {
+                if (currentHitIndex >= nAvailableHits || noiseHits->At(currentHitIndex).t() >= partEndTime)
+                    return false;
+                hit = noiseHits->At(currentHitIndex++) + tOffset;
+                return true;
+            });
         }
     }
 
-    // in case fNoiseTree is empty, simulate noise
-    else {
-        int nSegments = int(fNoiseWindowWidth / fPMTDeadtime);
-        float expected = darkRate * 1e3 * fPMTDeadtime * 1e-9;
+    if (res.nRemoved) {
+        std::cout << "[NoiseManager] Removed " << res.nRemoved << Form(" ( %d due to signal ) ", res.nRemovedBySignal)
+                  << "hits for PMT deadtime " << fPMTDeadtime << " ns\n";
+    }
 
-        unsigned int iMinPMT = !OD? 1 : 20001;
-        unsigned int iMaxPMT = !OD? MAXPM : 20000+MAXPMA;
+    //signalHits->CheckNaN();
+    if (!OD) fPartID++;
+}
 
-        for (unsigned int iPMT=iMinPMT; iPMT<=iMaxPMT; iPMT++) {
-            for (unsigned int iSeg=0; iSeg<=nSegments; iSeg++) {
-                int sampled = ranGen.Poisson(expected);
-                if (sampled) {
-                    float hitT = fNoiseStartTime + (iSeg + ranGen.Uniform()) * fPMTDeadtime;
-                    if (hitT < fNoiseEndTime) {
-                        float hitQ = abs(ranGen.Gaus(1, 0.7));
-                        PMTHit hit(hitT, hitQ, iPMT, 2/* in-gate */);
-                        signalHits->Append(hit);
-                    }
-                }
-            }
+HitReductionResult NoiseManager::MergeNoiseHits(PMTHitCluster* signalHits, std::function<bool(PMTHit&)> getNextNoiseHit)
+{
+    TVector3 tempVertex;
+    bool bHadVertex = signalHits->HasVertex();
+    if (bHadVertex) {
+        tempVertex = signalHits->GetVertex();
+        signalHits->RemoveVertex();
+    }
+    signalHits->Sort();
+
+    fMergedHits.clear();
+    fDeadtimeFilter.SetDeadtime(fPMTDeadtime);
+    fDeadtimeFilter.Reset();
+
+    // merge signal hits and noise hits in time order, applying deadtime on the fly
+    PMTHit noiseHit(0, 0, 1, 2);
+    bool hasNoiseHit = getNextNoiseHit(noiseHit);
+    unsigned int iSignalHit = 0, nSignalHits = signalHits->GetSize();
+    while (iSignalHit < nSignalHits || hasNoiseHit) {
+        if (!hasNoiseHit || (iSignalHit < nSignalHits && signalHits->At(iSignalHit).t() <= noiseHit.t())) {
+            PMTHit hit = signalHits->At(iSignalHit++);
+            if (fDeadtimeFilter.Accept(hit))
+                fMergedHits.push_back(hit);
+        }
+        else {
+            if (fDeadtimeFilter.Accept(noiseHit))
+                fMergedHits.push_back(noiseHit);
+            hasNoiseHit = getNextNoiseHit(noiseHit);
         }
     }
-    //fMsg.Print("ApplyDeadtime: ", pDEFAULT, false);
-    auto res = signalHits->ApplyDeadtime(fPMTDeadtime, true);
+
+    signalHits->Clear();
+    for (auto const& hit: fMergedHits)
+        signalHits->Append(hit);
     signalHits->Sort();
 
-    if (res.nRemoved) {
-        std::cout << "[NoiseManager] Removed " << res.nRemoved << Form(" ( %d due to signal ) ", res.nRemovedBySignal)
-                  << "hits for PMT deadtime " << fPMTDeadtime << " ns\n";
+    if (bHadVertex)
+        signalHits->SetVertex(tempVertex);
+
+    return fDeadtimeFilter.GetResult();
+}
+
+HitReductionResult NoiseManager::AddLibraryNoise(PMTHitCluster* signalHits, float partStartTime, float partEndTime, bool OD)
+{
+    auto const& entry = fNoiseLibrary.GetEntry((fNoiseLibraryOffset + fCurrentEntry) % fNEntries);
+    const NoiseLibraryHit* firstHit = fNoiseLibrary.GetHits(entry, OD);
+    const NoiseLibraryHit* lastHit = firstHit + fNoiseLibrary.GetNHits(entry, OD);
+
+    // hits are time-sorted in the library
+    auto libHit = std::lower_bound(firstHit, lastHit, partStartTime,
+                                   [](const NoiseLibraryHit& hit, float t) { return hit.t < t; });
+
+    Float tOffset = fNoiseStartTime - partStartTime;
+    return MergeNoiseHits(signalHits, [&](PMTHit& hit) {
+        if (libHit == lastHit || libHit->t >= partEndTime)
+            return false;
+        hit = PMTHit(libHit->t + tOffset, libHit->q, libHit->i, 2/* in-gate */);
+        ++libHit;
+        return true;
+    });
+}
+
+HitReductionResult NoiseManager::AddSimulatedNoise(PMTHitCluster* signalHits, float darkRate, bool OD)
+{
+    unsigned int iMinPMT = !OD? 1 : 20001;
+    unsigned int iMaxPMT = !OD? MAXPM : 20000+MAXPMA;
+
+    // one draw from the global generator per call (or the input event index, for stateless noise)
+    // keeps the noise reproducible with the noise seed,
+    // and each PMT gets an independent counter-based stream derived from it
+    uint64_t eventKey = fIsStateless ? CounterHash(fNoiseSeed, 2*(fNoiseEventOffset + fInputEventIndex) + OD)
+                                     : ranGen.Integer(4294967295);
+    std::vector<uint64_t> pmtCounter(iMaxPMT+1, 0);
+
+    // exponential inter-arrival times with mean 1/(dark rate);
+    // each PMT is dead for fPMTDeadtime after its own noise hit
+    double meanInterval = darkRate > 0 ? 1e6 / darkRate : 0; // ns
+    auto getNextHitTime = [&](unsigned int iPMT, double tLast) {
+        return tLast + CounterExp(CounterHash(eventKey, iPMT), pmtCounter[iPMT]++, meanInterval);
+    };
+
+    // min-heap of the next noise hit time of each PMT
+    typedef std::pair<double, unsigned int> NoiseArrival;
+    std::priority_queue<NoiseArrival, std::vector<NoiseArrival>, std::greater<NoiseArrival>> nextNoiseHits;
+    if (meanInterval > 0) {
+        for (unsigned int iPMT=iMinPMT; iPMT<=iMaxPMT; iPMT++) {
+            double hitT = getNextHitTime(iPMT, fNoiseStartTime);
+            if (hitT < fNoiseEndTime)
+                nextNoiseHits.push({hitT, iPMT});
+        }
     }
 
-    //signalHits->CheckNaN();
-    if (!OD) fPartID++;
+    return MergeNoiseHits(signalHits, [&](PMTHit& hit) {
+        if (nextNoiseHits.empty())
+            return false;
+
+        NoiseArrival arrival = nextNoiseHits.top();
+        nextNoiseHits.pop();
+
+        unsigned int iPMT = arrival.second;
+        float hitQ = std::abs(CounterGaus(CounterHash(eventKey, iPMT), pmtCounter[iPMT], 1, 0.7));
+        pmtCounter[iPMT] += 2;
+        hit = PMTHit(arrival.first, hitQ, iPMT, 2/* in-gate */);
+
+        double nextHitT = getNextHitTime(iPMT, arrival.first + fPMTDeadtime);
+        if (nextHitT < fNoiseEndTime)
+            nextNoiseHits.push({nextHitT, iPMT});
+        return true;
+    });
 }
 
 void NoiseManager::PopulateHitCluster(PMTHitCluster* hitCluster, bool OD)
 {
-    std::vector<float> t = !OD? fIDTQReal->T      : fODTQReal->T;
-    std::vector<float> q = !OD? fIDTQReal->Q      : fODTQReal->Q;
-    std::vector<int>   i = !OD? fIDTQReal->cables : fODTQReal->cables;
+    const std::vector<float>& t = !OD? fIDTQReal->T      : fODTQReal->T;
+    const std::vector<float>& q = !OD? fIDTQReal->Q      : fODTQReal->Q;
+    const std::vector<int>&   i = !OD? fIDTQReal->cables : fODTQReal->cables;
 
     unsigned int nRawHits = t.size();
 
     assert((t.size()==q.size()) && (q.size()==i.size()));
 
+    hitCluster->Reserve(hitCluster->GetSize() + nRawHits);
+
     for (unsigned int j=0; j<nRawHits; j++) {
         if (-1000e3 < t[j] && t[j] < 1000e3) {
             hitCluster->Append({t[j], q[j], i[j]&0x0000FFFF, 2/*in-gate flag*/});
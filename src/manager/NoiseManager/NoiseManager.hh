@@ -1,11 +1,16 @@
 #ifndef NOISEMANAGER_HH
 #define NOISEMANAGER_HH
 
+#include <functional>
 #include <vector>
 
 #include "Store.hh"
 #include "Printer.hh"
 #include "PMTHitCluster.hh"
+#include "DeadtimeFilter.hh"
+#include "NoiseLibrary.hh"
+#include "NoisePrefetcher.hh"
+#include "NoiseScheduler.hh"
 
 class TChain;
 class TQReal;
@@ -32,6 +37,11 @@ class NoiseManager
         void SetPMTDeadtime(float pmtDeadtime) { fPMTDeadtime = pmtDeadtime; }
         void SetDarkRate(float idRate, float odRate) { fIDDarkRatekHz = idRate; fODDarkRatekHz = odRate; }
         void SetNoiseMaxN200(int idCut, int odCut, bool doCut=true) { fIDMaxN200 = idCut; fODMaxN200 = odCut; fDoN200Cut = doCut; }
+        /**
+         * @brief If \c true, the noise N200 cut uses the maximum counts in fixed 200 ns bins
+         * instead of sliding 200 ns windows.
+         */
+        void SetBinnedN200(bool b) { fUseBinnedN200 = b; }
         void SetRepeat(bool b) { fDoRepeat = b; }
         void SetSeed(int seed) { fNoiseSeed = seed; ranGen.SetSeed(seed); }
         void SetSKGeneration(int gen) { fSKGen = gen; }
@@ -47,12 +57,19 @@ class NoiseManager
         void SetNoiseTreeFromList(TString pathToList);
         void SetNoiseTreeFromWildcard(TString wildcard, float tStart=0, float tEnd=535);
 
+        // noise library (see NoiseLibrary)
+        void SetNoiseLibrary(TString pathToLibrary, float tStart=0, float tEnd=535);
+
+        // stateless noise assignment (see NoiseScheduler)
+        void SetStatelessNoise(long eventOffset);
+        void SetInputEventIndex(long eventIndex) { fInputEventIndex = eventIndex; }
+
         // initialize from Store
         void ApplySettings(Store& store, int nInputEvents);
 
         // event navigation within tree
         void GetNextNoiseEvent(); // checks trigger, tree size and current entry
-        void SetNoiseEventHits(); // reads in noise hits from current noise entry
+        bool ReadNextNoiseEvent(PMTHitCluster* idHits, PMTHitCluster* odHits); // reads in noise hits from next usable entry
         void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
 
         // add noise to input PMTHitCluster
@@ -60,9 +77,10 @@ class NoiseManager
         void AddODNoise(PMTHitCluster* signalHits);
         void AddIDODNoise(PMTHitCluster* idSignalHits, PMTHitCluster* odSignalHits);
 
-        int GetCurrentRun() { return fHeader->nrunsk; }
-        int GetCurrentSubrun() { return fHeader->nsubsk; }
-        int GetCurrentEventID() { return fHeader->nevsk; }
+        int GetCurrentEntry() { return fCurrentEntry; }
+        int GetCurrentRun() { return fCurrentRun; }
+        int GetCurrentSubrun() { return fCurrentSubrun; }
+        int GetCurrentEventID() { return fCurrentEventID; }
         float GetCurrentHitTime() { return fIDNoiseEventHits[fCurrentIDHitIndex].t(); }
         float GetCurrentPartStartTime() { return fCurrentPartStartTime; }
         float GetCurrentPartEndTime() { return fCurrentPartEndTime; }
@@ -70,7 +88,22 @@ class NoiseManager
 
     protected:
         void PopulateHitCluster(PMTHitCluster* hitCluster, bool OD=false);
+        bool GoToNextEntry();
+        bool ReadNoiseEntry(PMTHitCluster* idHits, PMTHitCluster* odHits);
+        void ReopenNoiseTree();
+        bool IsBurstyNoiseEvent(int idMaxN200, int odMaxN200);
+        bool ReadNextLibraryEvent();
+        void UseScheduledSegment();
+        void SetNoiseEventTimeRange(float minT, float maxT);
+        HitReductionResult AddLibraryNoise(PMTHitCluster* signalHits, float partStartTime, float partEndTime, bool OD=false);
         void AddNoise(PMTHitCluster* signalHits, PMTHitCluster* noiseHits, int& currentHitIndex, float darkRate, bool OD=false);
+        HitReductionResult AddSimulatedNoise(PMTHitCluster* signalHits, float darkRate, bool OD=false);
+
+        /**
+         * @brief Merges time-ordered noise hits into \c signalHits, applying PMT deadtime on the fly.
+         * @param getNextNoiseHit Sets its argument to the next noise hit in time order, and returns \c false if there is none.
+         */
+        HitReductionResult MergeNoiseHits(PMTHitCluster* signalHits, std::function<bool(PMTHit&)> getNextNoiseHit);
 
     private:
         TChain* fNoiseTree;
@@ -79,6 +112,7 @@ class NoiseManager
         TString fNoisePath;
         TString fNoiseType;
         TString fNoiseCut;
+        std::vector<TString> fUsedNoiseFiles;
 
         Header* fHeader;
         TQReal* fIDTQReal;
@@ -101,10 +135,11 @@ class NoiseManager
         float fIDDarkRatekHz, fODDarkRatekHz;
 
         int fCurrentIDHitIndex, fCurrentODHitIndex, fCurrentEntry, fNEntries;
+        int fCurrentRun, fCurrentSubrun, fCurrentEventID;
         int fPartID, fNParts;
         float fCurrentPartStartTime, fCurrentPartEndTime;
 
-        bool fDoRepeat, fDoN200Cut;
+        bool fDoRepeat, fDoN200Cut, fUseBinnedN200;
 
         //std::vector<float> fT, fQ;
         //std::vector<int>   fI;
@@ -112,6 +147,18 @@ class NoiseManager
         PMTHitCluster fIDNoiseEventHits;
         PMTHitCluster fODNoiseEventHits;
 
+        DeadtimeFilter fDeadtimeFilter;
+        std::vector<PMTHit> fMergedHits;
+
+        NoiseLibrary fNoiseLibrary;
+        unsigned long fNoiseLibraryOffset;
+
+        NoisePrefetcher fNoisePrefetcher;
+
+        NoiseScheduler fNoiseScheduler;
+        bool fIsStateless;
+        long fNoiseEventOffset, fInputEventIndex, fScheduledEventIndex;
+
         Printer fMsg;
 };
 
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "NoiseManager.hh"
+#include "NoisePrefetcher.hh"
+
+// running prefetchers, whose pipes are closed in forked children;
+// only modified by the thread that starts and stops the prefetchers
+static std::vector<NoisePrefetcher*> gRunningPrefetchers;
+
+NoisePrefetcher::NoisePrefetcher(Verbosity verbose)
+: fPID(-1), fReadyFD(-1), fFreeFD(-1), fSlots(nullptr), fNSlots(0), fNPopped(0), fMsg("NoisePrefetcher", verbose) {}
+
+NoisePrefetcher::~NoisePrefetcher()
+{
+    Stop();
+}
+
+void NoisePrefetcher::Start(unsigned int nSlots, NoiseManager* noiseManager)
+{
+    if (IsRunning()) Stop();
+
+    void* slots = mmap(nullptr, nSlots*sizeof(PrefetchedNoiseEvent), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    int readyPipe[2], freePipe[2];
+    if (slots == MAP_FAILED || pipe(readyPipe) || pipe(freePipe))
+        fMsg.Print("Unable to allocate shared memory and pipes for noise prefetching!", pERROR);
+    for (int fd: {readyPipe[0], readyPipe[1], freePipe[0], freePipe[1]})
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    static bool isForkHandlerSet = (pthread_atfork(nullptr, nullptr, &NoisePrefetcher::CloseInChild) == 0);
+    (void)isForkHandlerSet;
+    fSlots  = static_cast<PrefetchedNoiseEvent*>(slots);
+    fNSlots = nSlots;
+    fNPopped = 0;
+
+    // flush buffered output so that it is not duplicated by the child
+    std::cout << std::flush;
+    fflush(stdout);
+
+    fPID = fork();
+    if (fPID < 0) {
+        fMsg.Print("Unable to fork noise reader!", pERROR);
+    }
+    else if (fPID == 0) {
+        // child: keep only its own pipe ends
+        close(readyPipe[0]); close(freePipe[1]);
+        fReadyFD = readyPipe[1];
+        fFreeFD  = freePipe[0];
+        RunReader(noiseManager);
+    }
+
+    close(readyPipe[1]); close(freePipe[0]);
+    fReadyFD = readyPipe[0];
+    fFreeFD  = freePipe[1];
+    gRunningPrefetchers.push_back(this);
+
+    fMsg.Print(Form("Started noise reader with %d prefetched events.", nSlots));
+}
+
+void NoisePrefetcher::Stop()
+{
+    if (!IsRunning()) return;
+
+    gRunningPrefetchers.erase(std::remove(gRunningPrefetchers.begin(), gRunningPrefetchers.end(), this),
+                              gRunningPrefetchers.end());
+
+    // the reader may be waiting for a free slot, or reading ahead
+    close(fFreeFD);
+    close(fReadyFD);
+    kill(fPID, SIGTERM);
+    waitpid(fPID, nullptr, 0);
+    munmap(fSlots, fNSlots*sizeof(PrefetchedNoiseEvent));
+
+    fPID = -1; fReadyFD = -1; fFreeFD = -1;
+    fSlots = nullptr; fNSlots = 0;
+}
+
+bool NoisePrefetcher::Pop(PMTHitCluster* idHits, PMTHitCluster* odHits, int& entry, int& run, int& subrun, int& event,
+                          bool& isOversize)
+{
+    char token;
+    if (read(fReadyFD, &token, 1) != 1)
+        fMsg.Print(Form("Noise reader (pid %d) terminated unexpectedly!", fPID), pERROR);
+
+    PrefetchedNoiseEvent* slot = fSlots + fNPopped % fNSlots;
+    if (slot->isLast) return false;
+
+    entry = slot->entry; run = slot->run; subrun = slot->subrun; event = slot->event;
+    isOversize = slot->isOversize;
+
+    const NoiseLibraryHit* hit = slot->hits;
+    for (int iHit=0; iHit<slot->nIDHits; iHit++, hit++)
+        idHits->Append({hit->t, hit->q, hit->i, 2/*in-gate flag*/});
+    for (int iHit=0; iHit<slot->nODHits; iHit++, hit++)
+        odHits->Append({hit->t, hit->q, hit->i, 2/*in-gate flag*/});
+    idHits->Sort();
+    odHits->Sort();
+
+    // hand the slot back to the reader
+    fNPopped++;
+    if (write(fFreeFD, &token, 1) != 1)
+        fMsg.Print(Form("Noise reader (pid %d) terminated unexpectedly!", fPID), pERROR);
+
+    return true;
+}
+
+void NoisePrefetcher::RunReader(NoiseManager* noiseManager)
+{
+    // interrupts are handled by the parent, which ends the reader with SIGTERM
+    signal(SIGINT, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGTERM, SIG_DFL);
+
+    PMTHitCluster idHits, odHits;
+
+    char token = 'n';
+    for (unsigned long iSlot=0; ; iSlot++) {
+
+        // wait for a free slot once all slots have been filled
+        if (iSlot >= fNSlots && read(fFreeFD, &token, 1) != 1) break;
+
+        PrefetchedNoiseEvent* slot = fSlots + iSlot % fNSlots;
+
+        idHits.Clear(); odHits.Clear();
+        bool hasNoiseEvent = noiseManager->ReadNextNoiseEvent(&idHits, &odHits);
+
+        // pass only the entry of events too large for the slot
+        slot->isOversize = hasNoiseEvent && idHits.GetSize() + odHits.GetSize() > NOISEPREFETCHMAXHITS;
+        if (slot->isOversize) hasNoiseEvent = false;
+
+        slot->isLast  = !hasNoiseEvent && !slot->isOversize;
+        slot->entry   = noiseManager->GetCurrentEntry();
+        slot->run     = noiseManager->GetCurrentRun();
+        slot->subrun  = noiseManager->GetCurrentSubrun();
+        slot->event   = noiseManager->GetCurrentEventID();
+        slot->nIDHits = hasNoiseEvent ? idHits.GetSize() : 0;
+        slot->nODHits = hasNoiseEvent ? odHits.GetSize() : 0;
+
+        NoiseLibraryHit* hit = slot->hits;
+        for (int iHit=0; iHit<slot->nIDHits; iHit++, hit++)
+            *hit = {(float)idHits[iHit].t(), (float)idHits[iHit].q(), (int32_t)idHits[iHit].i()};
+        for (int iHit=0; iHit<slot->nODHits; iHit++, hit++)
+            *hit = {(float)odHits[iHit].t(), (float)odHits[iHit].q(), (int32_t)odHits[iHit].i()};
+
+        if (write(fReadyFD, &token, 1) != 1 || slot->isLast) break;
+    }
+
+    // leave without running the parent's destructors and exit handlers
+    _exit(0);
+}
+
+void NoisePrefetcher::CloseInChild()
+{
+    for (auto& prefetcher: gRunningPrefetchers) {
+        close(prefetcher->fReadyFD);
+        close(prefetcher->fFreeFD);
+        prefetcher->fReadyFD = -1; prefetcher->fFreeFD = -1;
+    }
+    gRunningPrefetchers.clear();
+}
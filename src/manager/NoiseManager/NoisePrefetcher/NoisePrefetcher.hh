@@ -0,0 +1,86 @@
+/**
+ * @file NoisePrefetcher.hh
+ */
+
+#ifndef NOISEPREFETCHER_HH
+#define NOISEPREFETCHER_HH
+
+#include <sys/types.h>
+
+#include "PMTHitCluster.hh"
+#include "NoiseLibrary.hh"
+#include "Printer.hh"
+
+class NoiseManager;
+
+/** Maximum number of ID and OD hits in a noise event that can be passed through NoisePrefetcher;
+ * larger noise events are read again by NoiseManager itself. */
+#define NOISEPREFETCHMAXHITS 1000000
+
+/**
+ * @brief A selected and time-sorted noise event in the NoisePrefetcher ring buffer.
+ */
+typedef struct PrefetchedNoiseEvent {
+    int entry, run, subrun, event;
+    int isLast;            ///< the noise tree ended without repetition; no hits
+    int isOversize;        ///< the event has more than \c NOISEPREFETCHMAXHITS hits; no hits
+    int nIDHits, nODHits;
+    NoiseLibraryHit hits[NOISEPREFETCHMAXHITS]; ///< ID hits followed by OD hits
+} PrefetchedNoiseEvent;
+
+/**
+ * @brief Reads noise events ahead of NoiseManager in a forked process.
+ *
+ * @details ROOT I/O can't be shared between threads, so the noise tree is read
+ * by a child process with its own copy of NoiseManager. The child reads,
+ * selects, and sorts the noise events in the same order as NoiseManager would,
+ * and writes them into a ring buffer of shared memory slots.
+ * A pair of pipes signals filled and freed slots. Random numbers are drawn
+ * only by the parent, so the noise is identical with and without prefetching
+ * for the same noise seed.
+ *
+ * The pipes are closed in any other child forked afterwards (e.g., LOWFIT
+ * workers), so that NoisePrefetcher::Stop is never blocked by a child
+ * holding them open.
+ */
+class NoisePrefetcher
+{
+    public:
+        NoisePrefetcher(Verbosity verbose=pDEFAULT);
+        ~NoisePrefetcher();
+
+        /**
+         * @brief Forks a reader process that keeps up to \c nSlots noise events of \c noiseManager ready.
+         */
+        void Start(unsigned int nSlots, NoiseManager* noiseManager);
+        void Stop();
+
+        bool IsRunning() const { return fSlots != nullptr; }
+
+        /**
+         * @brief Takes the next noise event from the ring buffer.
+         * @param isOversize Set to \c true if the event at \c entry was too large
+         * for a slot and its hits are not filled; the caller reads the entry itself.
+         * @return \c false if the noise tree ended without repetition.
+         */
+        bool Pop(PMTHitCluster* idHits, PMTHitCluster* odHits, int& entry, int& run, int& subrun, int& event,
+                 bool& isOversize);
+
+        void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
+
+    private:
+        void RunReader(NoiseManager* noiseManager);
+
+        static void CloseInChild();
+
+        pid_t fPID;
+        int fReadyFD, fFreeFD;
+
+        PrefetchedNoiseEvent* fSlots;
+        unsigned int fNSlots;
+        unsigned long fNPopped;
+
+        Printer fMsg;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include <algorithm>
+
+#include "Calculator.hh"
+#include "NoiseScheduler.hh"
+
+NoiseScheduler::NoiseScheduler()
+: fSeed(0), fWindowWidth(535e3), fNSegments(0), fHalfBits(1) {}
+
+void NoiseScheduler::Clear()
+{
+    fEntries.clear(); fMinT.clear(); fSpareT.clear(); fFirstSegment.clear();
+    fNSegments = 0;
+    fHalfBits = 1;
+}
+
+void NoiseScheduler::AddNoiseEvent(int entry, float minT, float maxT)
+{
+    int nParts = (int)((maxT - minT) / fWindowWidth);
+    if (nParts < 1) return;
+
+    fEntries.push_back(entry);
+    fMinT.push_back(minT);
+    fSpareT.push_back((maxT - minT) - nParts*fWindowWidth);
+    fFirstSegment.push_back(fNSegments);
+    fNSegments += nParts;
+
+    // the permutation works on a domain of 2^(2*fHalfBits) >= fNSegments
+    while ((1ULL << (2*fHalfBits)) < fNSegments) fHalfBits++;
+}
+
+NoiseSegment NoiseScheduler::GetSegment(uint64_t eventIndex) const
+{
+    NoiseSegment segment;
+    segment.pass = eventIndex / fNSegments;
+
+    uint64_t passKey = CounterHash(fSeed, segment.pass);
+    uint64_t iSegment = Permute(eventIndex % fNSegments, passKey);
+
+    // noise event containing the segment
+    unsigned int iEvent = std::upper_bound(fFirstSegment.begin(), fFirstSegment.end(), iSegment) - fFirstSegment.begin() - 1;
+    uint64_t nextFirstSegment = iEvent+1 < fFirstSegment.size() ? fFirstSegment[iEvent+1] : fNSegments;
+
+    segment.entry  = fEntries[iEvent];
+    segment.part   = iSegment - fFirstSegment[iEvent];
+    segment.nParts = nextFirstSegment - fFirstSegment[iEvent];
+    segment.t0     = fMinT[iEvent] + fSpareT[iEvent] * CounterUniform(CounterHash(passKey, ~0ULL), iEvent);
+
+    return segment;
+}
+
+uint64_t NoiseScheduler::Permute(uint64_t index, uint64_t key) const
+{
+    // balanced Feistel network over 2*fHalfBits bits,
+    // cycle-walking until the result is within the segment range
+    uint64_t mask = (1ULL << fHalfBits) - 1;
+    do {
+        uint64_t left = index >> fHalfBits, right = index & mask;
+        for (uint64_t iRound=0; iRound<4; iRound++) {
+            uint64_t newRight = left ^ (CounterHash(key, (iRound << 32) | right) & mask);
+            left = right; right = newRight;
+        }
+        index = (left << fHalfBits) | right;
+    } while (index >= fNSegments);
+
+    return index;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file NoiseScheduler.hh
+ */
+
+#ifndef NOISESCHEDULER_HH
+#define NOISESCHEDULER_HH
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief A noise time window assigned to an input event by NoiseScheduler.
+ */
+typedef struct NoiseSegment {
+    int entry;          ///< noise tree (or library) entry
+    int part, nParts;   ///< part of the noise event, and the number of parts in it
+    float t0;           ///< start time of the first part (ns)
+    unsigned long pass; ///< number of times all noise segments have been used before
+} NoiseSegment;
+
+/**
+ * @brief Stateless assignment of noise segments to input events.
+ *
+ * @details Each usable noise event is split into as many non-overlapping parts
+ * of the noise window width as it can hold, and all parts form a list of noise segments.
+ * The input event with global index \c i is assigned the segment at position
+ * \c i in a pseudo-random permutation of the list, which depends only on the seed
+ * and on the pass \c i / (number of segments). The offset of the first part
+ * in each noise event is drawn in the same way. Input events split across jobs
+ * therefore get the same noise as in a single job, as long as the global index
+ * and the list of noise events are the same.
+ */
+class NoiseScheduler
+{
+    public:
+        NoiseScheduler();
+
+        void Clear();
+        void SetSeed(uint64_t seed) { fSeed = seed; }
+        void SetWindowWidth(float width) { fWindowWidth = width; }
+
+        /**
+         * @brief Adds a usable noise event covering [\c minT, \c maxT] (ns).
+         * @details Events shorter than the window width are ignored.
+         * Events must be added in the same order in all jobs.
+         */
+        void AddNoiseEvent(int entry, float minT, float maxT);
+
+        bool IsReady() const { return fNSegments > 0; }
+        uint64_t GetNSegments() const { return fNSegments; }
+        unsigned int GetNNoiseEvents() const { return fEntries.size(); }
+
+        /**
+         * @brief Returns the noise segment for the input event with global index \c eventIndex.
+         */
+        NoiseSegment GetSegment(uint64_t eventIndex) const;
+
+    private:
+        uint64_t Permute(uint64_t index, uint64_t key) const;
+
+        uint64_t fSeed;
+        float fWindowWidth;
+
+        std::vector<int>      fEntries;
+        std::vector<float>    fMinT, fSpareT;  // start time and length not covered by parts
+        std::vector<uint64_t> fFirstSegment;   // index of the first segment of each noise event
+        uint64_t fNSegments;
+
+        unsigned int fHalfBits;
+};
+
+#endif
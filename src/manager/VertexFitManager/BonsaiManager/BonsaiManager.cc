@@ -156,6 +156,20 @@ void BonsaiManager::Fit(const PMTHitCluster& hitCluster)
     }
 }
 
+std::string BonsaiManager::GetConfigString()
+{
+    if (!fUseLOWFIT)
+        return Form("bonsai %d", skheadg_.sk_geometry);
+
+    // LOWFIT output depends on the run number and MC/data flag of the current event,
+    // and on the bad channels of the subrun and the water transparency
+    bool isMC = (skhead_.mdrnsk == 0);
+    int runNo = (isMC || fRefRunNo) ? fRefRunNo : skhead_.nrunsk;
+    int subrunNo = isMC ? 0 : skhead_.nsubsk;
+    return Form("lowfit %d %d %d %d %d %d %g", skheadg_.sk_geometry, fUseSKG4Parameter, isMC,
+                runNo, subrunNo, fRefRunNo, waterTransparency);
+}
+
 void BonsaiManager::FitLOWFIT(const PMTHitCluster& hitCluster)
 {
     // clear sktq
@@ -244,6 +258,19 @@ void BonsaiManager::FitLOWFIT(const PMTHitCluster& hitCluster)
     }
 }
 
+FitResult BonsaiManager::GetFitResult()
+{
+    return {fFitVertex, fFitTime, fFitGoodness, fFitEnergy, fFitDirKS, fFitOvaQ};
+}
+
+void BonsaiManager::SetFitResult(const FitResult& result)
+{
+    VertexFitManager::SetFitResult(result);
+    fFitEnergy = result.energy;
+    fFitDirKS = result.dirKS;
+    fFitOvaQ = result.ovaQ;
+}
+
 void BonsaiManager::DumpFitResult()
 {
     fMsg.Print(Form("Fit vertex: %3.2f, %3.2f, %3.2f", fFitVertex.x(), fFitVertex.y(), fFitVertex.z()));
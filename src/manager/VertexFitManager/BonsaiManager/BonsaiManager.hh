@@ -21,6 +21,7 @@ class BonsaiManager : public VertexFitManager
         void UseSKG4Parameter(bool turnOn=true);
         void Fit(const PMTHitCluster& hitCluster);
         void FitLOWFIT(const PMTHitCluster& hitCluster);
+        std::string GetConfigString();
 
         inline unsigned int GetRefRunNo() { return fRefRunNo; }
         inline void SetRefRunNo(unsigned int no) { fRefRunNo = no; }
@@ -28,6 +29,8 @@ class BonsaiManager : public VertexFitManager
         inline float GetFitEnergy() { return fFitEnergy; }
         inline float GetFitDirKS() { return fFitDirKS; }
         inline float GetFitOvaQ() { return fFitOvaQ; }
+        FitResult GetFitResult();
+        void SetFitResult(const FitResult& result);
 
         void DumpFitResult();
         static bool IsLOWFITInitialized() { return fIsLOWFITInitialized; }
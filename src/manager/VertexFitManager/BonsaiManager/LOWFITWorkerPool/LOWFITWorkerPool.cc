@@ -0,0 +1,245 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "skparmC.h"
+#include "skheadC.h"
+#include "skbadcC.h"
+
+#include "BonsaiManager.hh"
+#include "LOWFITWorkerPool.hh"
+
+/**
+ * @brief Per-run common blocks shared by the parent and the LOWFIT workers.
+ */
+typedef struct LOWFITRunState {
+    int nrunsk, nsubsk;
+    decltype(combad_)   badID;
+    decltype(combada_)  badOD;
+    decltype(combad00_) badID0;
+    decltype(comdark_)  dark;
+} LOWFITRunState;
+
+LOWFITWorkerPool::LOWFITWorkerPool(Verbosity verbose)
+: fRunState(nullptr), fRunStateID(0), fMsg("LOWFITWorkerPool", verbose) {}
+
+LOWFITWorkerPool::~LOWFITWorkerPool()
+{
+    Stop();
+}
+
+void LOWFITWorkerPool::Start(unsigned int nWorkers, BonsaiManager* fitter)
+{
+    if (IsRunning()) Stop();
+
+    void* runState = mmap(nullptr, sizeof(LOWFITRunState), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (runState == MAP_FAILED)
+        fMsg.Print("Unable to allocate shared memory for LOWFIT workers!", pERROR);
+    fRunState = static_cast<LOWFITRunState*>(runState);
+    UpdateRunState();
+
+    for (unsigned int iWorker=0; iWorker<nWorkers; iWorker++) {
+        Worker worker;
+
+        void* slot = mmap(nullptr, sizeof(LOWFITJob), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        int jobPipe[2], donePipe[2];
+        if (slot == MAP_FAILED || pipe(jobPipe) || pipe(donePipe))
+            fMsg.Print("Unable to allocate shared memory and pipes for LOWFIT workers!", pERROR);
+        worker.job = static_cast<LOWFITJob*>(slot);
+
+        // flush buffered output so that it is not duplicated by the child
+        std::cout << std::flush;
+        fflush(stdout);
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            fMsg.Print(Form("Unable to fork LOWFIT worker #%d!", iWorker), pERROR);
+        }
+        else if (pid == 0) {
+            // child: keep only its own pipe ends
+            close(jobPipe[1]); close(donePipe[0]);
+            for (auto const& sibling: fWorkers) {
+                close(sibling.jobFD); close(sibling.doneFD);
+            }
+            worker.jobFD  = jobPipe[0];
+            worker.doneFD = donePipe[1];
+            RunWorker(worker, fitter);
+        }
+
+        close(jobPipe[0]); close(donePipe[1]);
+        worker.pid    = pid;
+        worker.jobFD  = jobPipe[1];
+        worker.doneFD = donePipe[0];
+        fWorkers.push_back(worker);
+    }
+
+    fMsg.Print(Form("Started %d LOWFIT workers.", nWorkers));
+}
+
+void LOWFITWorkerPool::Stop()
+{
+    // closing the job pipe makes the worker leave its loop
+    for (auto& worker: fWorkers)
+        close(worker.jobFD);
+
+    for (auto& worker: fWorkers) {
+        waitpid(worker.pid, nullptr, 0);
+        close(worker.doneFD);
+        munmap(worker.job, sizeof(LOWFITJob));
+    }
+
+    fWorkers.clear();
+
+    if (fRunState) munmap(fRunState, sizeof(LOWFITRunState));
+    fRunState = nullptr;
+}
+
+void LOWFITWorkerPool::UpdateRunState()
+{
+    // called only while all workers are idle
+    fRunState->nrunsk = skhead_.nrunsk;
+    fRunState->nsubsk = skhead_.nsubsk;
+    fRunState->badID  = combad_;
+    fRunState->badOD  = combada_;
+    fRunState->badID0 = combad00_;
+    fRunState->dark   = comdark_;
+    fRunStateID++;
+}
+
+std::vector<FitResult> LOWFITWorkerPool::Fit(const std::vector<PMTHitCluster>& hitWindows)
+{
+    // share the per-run common blocks of the new run with the workers
+    if (skhead_.nrunsk != fRunState->nrunsk || skhead_.nsubsk != fRunState->nsubsk)
+        UpdateRunState();
+
+    unsigned int nJobs = hitWindows.size();
+    std::vector<FitResult> results(nJobs);
+    std::vector<int> jobIndex(fWorkers.size(), -1);
+
+    unsigned int nSubmitted = 0, nCollected = 0;
+    while (nCollected < nJobs) {
+
+        // hand out jobs to idle workers
+        for (unsigned int iWorker=0; iWorker<fWorkers.size() && nSubmitted<nJobs; iWorker++) {
+            if (jobIndex[iWorker] < 0) {
+                Submit(fWorkers[iWorker], hitWindows[nSubmitted]);
+                jobIndex[iWorker] = nSubmitted++;
+            }
+        }
+
+        // wait for any busy worker to finish
+        std::vector<pollfd> fds;
+        std::vector<unsigned int> busyWorkers;
+        for (unsigned int iWorker=0; iWorker<fWorkers.size(); iWorker++) {
+            if (jobIndex[iWorker] >= 0) {
+                fds.push_back({fWorkers[iWorker].doneFD, POLLIN, 0});
+                busyWorkers.push_back(iWorker);
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            fMsg.Print("Unable to poll LOWFIT workers!", pERROR);
+        }
+
+        for (unsigned int iFD=0; iFD<fds.size(); iFD++) {
+            if (fds[iFD].revents) {
+                unsigned int iWorker = busyWorkers[iFD];
+                results[jobIndex[iWorker]] = Collect(fWorkers[iWorker]);
+                jobIndex[iWorker] = -1;
+                nCollected++;
+            }
+        }
+    }
+
+    return results;
+}
+
+void LOWFITWorkerPool::Submit(Worker& worker, const PMTHitCluster& hitWindow)
+{
+    LOWFITJob* job = worker.job;
+    job->nrunsk = skhead_.nrunsk;
+    job->mdrnsk = skhead_.mdrnsk;
+    job->runStateID = fRunStateID;
+
+    int nHits = hitWindow.GetSize();
+    if (nHits > LOWFITMAXHITS) {
+        fMsg.Print(Form("Hit window with %d hits is truncated to %d hits for LOWFIT worker...", nHits, LOWFITMAXHITS), pWARNING);
+        nHits = LOWFITMAXHITS;
+    }
+
+    job->nHits = nHits;
+    for (int iHit=0; iHit<nHits; iHit++) {
+        auto const& hit = hitWindow[iHit];
+        job->t[iHit] = hit.t();
+        job->q[iHit] = hit.q();
+        job->i[iHit] = hit.i();
+    }
+
+    char command = 'f';
+    if (write(worker.jobFD, &command, 1) != 1)
+        fMsg.Print(Form("Unable to submit a job to LOWFIT worker (pid %d)!", worker.pid), pERROR);
+}
+
+FitResult LOWFITWorkerPool::Collect(Worker& worker)
+{
+    char reply;
+    if (read(worker.doneFD, &reply, 1) != 1)
+        fMsg.Print(Form("LOWFIT worker (pid %d) terminated unexpectedly!", worker.pid), pERROR);
+
+    LOWFITJob* job = worker.job;
+    return {TVector3(job->vertex), job->time, job->goodness, job->energy, job->dirKS, job->ovaQ};
+}
+
+void LOWFITWorkerPool::RunWorker(Worker& worker, BonsaiManager* fitter)
+{
+    // interrupts and output files are handled by the parent
+    signal(SIGINT, SIG_IGN);
+
+    fitter->InitializeLOWFIT(fitter->GetRefRunNo());
+
+    // the run state at fork is already in the common blocks
+    int runStateID = fRunStateID;
+
+    char command;
+    while (read(worker.jobFD, &command, 1) == 1) {
+        LOWFITJob* job = worker.job;
+        if (job->runStateID != runStateID) {
+            skhead_.nsubsk = fRunState->nsubsk;
+            combad_   = fRunState->badID;
+            combada_  = fRunState->badOD;
+            combad00_ = fRunState->badID0;
+            comdark_  = fRunState->dark;
+            runStateID = job->runStateID;
+        }
+        skhead_.nrunsk = job->nrunsk;
+        skhead_.mdrnsk = job->mdrnsk;
+
+        PMTHitCluster hitWindow;
+        for (int iHit=0; iHit<job->nHits; iHit++)
+            hitWindow.Append({job->t[iHit], job->q[iHit], job->i[iHit], 2});
+
+        fitter->FitLOWFIT(hitWindow);
+        auto result = fitter->GetFitResult();
+
+        job->vertex[0] = result.vertex.x();
+        job->vertex[1] = result.vertex.y();
+        job->vertex[2] = result.vertex.z();
+        job->time      = result.time;
+        job->goodness  = result.goodness;
+        job->energy    = result.energy;
+        job->dirKS     = result.dirKS;
+        job->ovaQ      = result.ovaQ;
+
+        if (write(worker.doneFD, &command, 1) != 1) break;
+    }
+
+    // leave without running the parent's destructors and exit handlers
+    _exit(0);
+}
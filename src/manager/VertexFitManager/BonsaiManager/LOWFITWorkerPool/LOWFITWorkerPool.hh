@@ -0,0 +1,96 @@
+/**
+ * @file LOWFITWorkerPool.hh
+ */
+
+#ifndef LOWFITWORKERPOOL_HH
+#define LOWFITWORKERPOOL_HH
+
+#include <vector>
+#include <sys/types.h>
+
+#include "PMTHitCluster.hh"
+#include "VertexFitManager.hh"
+#include "Printer.hh"
+
+class BonsaiManager;
+struct LOWFITRunState;
+
+/** Maximum number of hits in a hit window that can be passed to a LOWFIT worker */
+#define LOWFITMAXHITS 2000
+
+/**
+ * @brief A hit window and its fit result shared between NTag and a LOWFIT worker.
+ */
+typedef struct LOWFITJob {
+    // input
+    int nrunsk, mdrnsk;
+    int runStateID; ///< LOWFITRunState the job should be fitted with
+    int nHits;
+    float t[LOWFITMAXHITS], q[LOWFITMAXHITS];
+    int   i[LOWFITMAXHITS];
+
+    // output
+    float vertex[3];
+    float time, goodness, energy, dirKS, ovaQ;
+} LOWFITJob;
+
+/**
+ * @brief Pool of forked LOWFIT helper processes.
+ *
+ * @details LOWFIT reads its input from the SK common blocks and can't be run
+ * in parallel within one process. Each worker is a child process with its own
+ * copy of the common blocks, initialized once with BonsaiManager::InitializeLOWFIT.
+ * Hit windows and fit results are exchanged through a shared memory slot
+ * per worker, and a pair of pipes signals job submission and completion.
+ *
+ * The workers are forked once, before the NN libraries start their threads.
+ * The per-run state of the common blocks (run/subrun, bad channels, dark rates)
+ * is copied to another shared memory region when the run or subrun of the
+ * fitted event changes, and each worker takes it over with its next job.
+ * The water transparency is set from the reference run at initialization
+ * and does not change within a process.
+ */
+class LOWFITWorkerPool
+{
+    public:
+        LOWFITWorkerPool(Verbosity verbose=pDEFAULT);
+        ~LOWFITWorkerPool();
+
+        /**
+         * @brief Forks \c nWorkers helper processes that fit with a copy of \c fitter.
+         */
+        void Start(unsigned int nWorkers, BonsaiManager* fitter);
+        void Stop();
+
+        bool IsRunning() const { return !fWorkers.empty(); }
+        unsigned int GetNWorkers() const { return fWorkers.size(); }
+
+        /**
+         * @brief Fits the given hit windows in parallel,
+         * updating the per-run state of the workers first if the run or subrun has changed.
+         * @return Fit results in the same order as \c hitWindows.
+         */
+        std::vector<FitResult> Fit(const std::vector<PMTHitCluster>& hitWindows);
+
+        void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
+
+    private:
+        typedef struct Worker {
+            pid_t pid;
+            int jobFD, doneFD;
+            LOWFITJob* job;
+        } Worker;
+
+        void Submit(Worker& worker, const PMTHitCluster& hitWindow);
+        FitResult Collect(Worker& worker);
+        void RunWorker(Worker& worker, BonsaiManager* fitter);
+        void UpdateRunState();
+
+        std::vector<Worker> fWorkers;
+        LOWFITRunState* fRunState;
+        int fRunStateID;
+
+        Printer fMsg;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include <cstdio>
+#include <fstream>
+
+#include "FitResultCache.hh"
+
+namespace
+{
+    const char     CACHEMAGIC[4]  = {'N', 'T', 'F', 'C'};
+    const uint32_t CACHEVERSION   = 1;
+    const uint64_t FNVOFFSETBASIS = 14695981039346656037ULL;
+    const uint64_t FNVPRIME       = 1099511628211ULL;
+
+    inline void HashBytes(uint64_t& hash, const void* data, size_t size)
+    {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i=0; i<size; i++) {
+            hash ^= bytes[i];
+            hash *= FNVPRIME;
+        }
+    }
+}
+
+FitResultCache::FitResultCache(Verbosity verbose)
+: fNFound(0), fNMissed(0), fNLoaded(0), fIsModified(false), fMsg("FitResultCache", verbose) {}
+
+FitResultCache::~FitResultCache() {}
+
+void FitResultCache::Open(std::string filePath)
+{
+    fFilePath = filePath;
+    fEntries.clear();
+
+    std::ifstream file(fFilePath, std::ios::binary);
+    if (!file.is_open()) {
+        fMsg.Print(Form("Creating a new fit cache at %s...", fFilePath.c_str()));
+        return;
+    }
+
+    char magic[4]; uint32_t version = 0; uint64_t nEntries = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&nEntries), sizeof(nEntries));
+
+    if (!file || std::string(magic, 4) != std::string(CACHEMAGIC, 4) || version != CACHEVERSION) {
+        fMsg.Print(Form("%s is not a valid fit cache file, starting with an empty cache...", fFilePath.c_str()), pWARNING);
+        return;
+    }
+
+    fEntries.reserve(nEntries);
+    for (uint64_t iEntry=0; iEntry<nEntries; iEntry++) {
+        uint64_t key; CacheEntry entry;
+        file.read(reinterpret_cast<char*>(&key), sizeof(key));
+        file.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+        if (!file) {
+            fMsg.Print(Form("Fit cache file %s is truncated after %lu entries.", fFilePath.c_str(), (unsigned long)iEntry), pWARNING);
+            break;
+        }
+        fEntries[key] = entry;
+    }
+
+    fNLoaded = fEntries.size();
+    fMsg.Print(Form("Loaded %lu fit results from %s", fNLoaded, fFilePath.c_str()));
+}
+
+void FitResultCache::Save()
+{
+    if (!IsOpen() || !fIsModified) return;
+
+    // write to a temporary file first so that an interrupted run does not corrupt the cache
+    std::string tmpPath = fFilePath + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        fMsg.Print(Form("Unable to write fit cache to %s!", tmpPath.c_str()), pWARNING);
+        return;
+    }
+
+    uint64_t nEntries = fEntries.size();
+    file.write(CACHEMAGIC, sizeof(CACHEMAGIC));
+    file.write(reinterpret_cast<const char*>(&CACHEVERSION), sizeof(CACHEVERSION));
+    file.write(reinterpret_cast<const char*>(&nEntries), sizeof(nEntries));
+    for (auto const& pair: fEntries) {
+        file.write(reinterpret_cast<const char*>(&pair.first), sizeof(pair.first));
+        file.write(reinterpret_cast<const char*>(&pair.second), sizeof(pair.second));
+    }
+    file.close();
+
+    if (!file || std::rename(tmpPath.c_str(), fFilePath.c_str()))
+        fMsg.Print(Form("Unable to write fit cache to %s!", fFilePath.c_str()), pWARNING);
+    else
+        fIsModified = false;
+}
+
+uint64_t FitResultCache::GetKey(const std::string& fitterConfig, const PMTHitCluster& hitWindow)
+{
+    uint64_t hash = FNVOFFSETBASIS;
+    HashBytes(hash, fitterConfig.data(), fitterConfig.size());
+
+    for (auto const& hit: hitWindow) {
+        // fitters take single precision input and
+        // reset ToF correction with their own vertex
+        float t = hit.GetRawTime(), q = hit.q();
+        int   i = hit.i();
+        HashBytes(hash, &t, sizeof(t));
+        HashBytes(hash, &q, sizeof(q));
+        HashBytes(hash, &i, sizeof(i));
+    }
+
+    return hash;
+}
+
+bool FitResultCache::Find(uint64_t key, unsigned int nHits, FitResult& result)
+{
+    auto it = fEntries.find(key);
+    if (it == fEntries.end() || it->second.nHits != nHits) {
+        fNMissed++;
+        return false;
+    }
+
+    auto const& entry = it->second;
+    result.vertex   = TVector3(entry.vertex[0], entry.vertex[1], entry.vertex[2]);
+    result.time     = entry.time;
+    result.goodness = entry.goodness;
+    result.energy   = entry.energy;
+    result.dirKS    = entry.dirKS;
+    result.ovaQ     = entry.ovaQ;
+    fNFound++;
+    return true;
+}
+
+void FitResultCache::Insert(uint64_t key, unsigned int nHits, const FitResult& result)
+{
+    CacheEntry entry;
+    entry.nHits     = nHits;
+    entry.vertex[0] = result.vertex.x();
+    entry.vertex[1] = result.vertex.y();
+    entry.vertex[2] = result.vertex.z();
+    entry.time      = result.time;
+    entry.goodness  = result.goodness;
+    entry.energy    = result.energy;
+    entry.dirKS     = result.dirKS;
+    entry.ovaQ      = result.ovaQ;
+    fEntries[key] = entry;
+    fIsModified = true;
+}
+
+void FitResultCache::DumpStatistics()
+{
+    unsigned long nLookups = fNFound + fNMissed;
+    fMsg.Print(Form("Fit cache %s: %lu hits / %lu lookups (%3.1f%%), %lu entries loaded, %lu entries total",
+                    fFilePath.c_str(), fNFound, nLookups, nLookups ? 100.*fNFound/nLookups : 0.,
+                    fNLoaded, (unsigned long)fEntries.size()));
+}
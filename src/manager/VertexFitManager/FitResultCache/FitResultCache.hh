@@ -0,0 +1,68 @@
+/**
+ * @file FitResultCache.hh
+ */
+
+#ifndef FITRESULTCACHE_HH
+#define FITRESULTCACHE_HH
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "PMTHitCluster.hh"
+#include "VertexFitManager.hh"
+#include "Printer.hh"
+
+/**
+ * @brief On-disk cache of delayed vertex fit results.
+ *
+ * @details Each entry is keyed by a 64-bit FNV-1a hash of the fitter
+ * configuration (VertexFitManager::GetConfigString) and the time, charge,
+ * and cable number of every hit in the fit window. Re-running NTag on the
+ * same input with different tagging cuts then skips the fits entirely.
+ * The number of hits in the window is kept with each entry as a guard
+ * against hash collisions.
+ */
+class FitResultCache
+{
+    public:
+        FitResultCache(Verbosity verbose=pDEFAULT);
+        ~FitResultCache();
+
+        /**
+         * @brief Loads the cache file at \c filePath, if it exists.
+         * New entries are written to the same path by FitResultCache::Save.
+         */
+        void Open(std::string filePath);
+        void Save();
+        bool IsOpen() const { return !fFilePath.empty(); }
+
+        static uint64_t GetKey(const std::string& fitterConfig, const PMTHitCluster& hitWindow);
+
+        /**
+         * @brief Looks up \c key and fills \c result if found.
+         * @return \c true if the key was found in the cache.
+         */
+        bool Find(uint64_t key, unsigned int nHits, FitResult& result);
+        void Insert(uint64_t key, unsigned int nHits, const FitResult& result);
+
+        void DumpStatistics();
+        void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
+
+    private:
+        typedef struct CacheEntry {
+            uint32_t nHits;
+            float vertex[3];
+            float time, goodness, energy, dirKS, ovaQ;
+        } CacheEntry;
+
+        std::unordered_map<uint64_t, CacheEntry> fEntries;
+        std::string fFilePath;
+
+        unsigned long fNFound, fNMissed, fNLoaded;
+        bool fIsModified;
+
+        Printer fMsg;
+};
+
+#endif
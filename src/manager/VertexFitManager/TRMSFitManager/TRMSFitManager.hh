@@ -18,6 +18,10 @@ class TRMSFitManager : public VertexFitManager
         }
 
         void Fit(const PMTHitCluster& hitCluster);
+        std::string GetConfigString()
+        {
+            return Form("trms %f %f %f %f", INITGRIDWIDTH, MINGRIDWIDTH, GRIDSHRINKRATE, VTXMAXRADIUS);
+        }
 
     private:
         float INITGRIDWIDTH, MINGRIDWIDTH, GRIDSHRINKRATE, VTXMAXRADIUS;
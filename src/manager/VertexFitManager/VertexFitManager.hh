@@ -5,10 +5,21 @@
 #ifndef VERTEXFITMANAGER_HH
 #define VERTEXFITMANAGER_HH
 
+#include <string>
+
 #include "TVector3.h"
 #include "PMTHitCluster.hh"
 #include "Printer.hh"
 
+/**
+ * @brief Output of a single delayed vertex fit.
+ */
+typedef struct FitResult {
+    TVector3 vertex;
+    float time, goodness;
+    float energy, dirKS, ovaQ;
+} FitResult;
+
 /**
  * @brief Manager class for all delayed vertex fitters.
  */
@@ -22,6 +33,16 @@ class VertexFitManager
         TVector3 GetFitVertex() { return fFitVertex; }
         float GetFitTime() { return fFitTime; }
         float GetFitGoodness() { return fFitGoodness; }
+        virtual FitResult GetFitResult() { return {fFitVertex, fFitTime, fFitGoodness, -1, -1, -1}; }
+        virtual void SetFitResult(const FitResult& result)
+        {
+            fFitVertex = result.vertex; fFitTime = result.time; fFitGoodness = result.goodness;
+        }
+        /**
+         * @brief Returns a string that identifies the fitter and all settings that affect its output.
+         * @see FitResultCache
+         */
+        virtual std::string GetConfigString() = 0;
         void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
 
         /**
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "AsyncLogSink.hh"
+
+static const size_t PUTAREASIZE = 1 << 12;
+static const size_t FLUSHSIZE   = 1 << 16;
+static const auto FLUSHINTERVAL = std::chrono::milliseconds(200);
+
+// never destroyed, as it is used by the exit handler
+static std::mutex* gOpenSinksMutex = new std::mutex;
+static std::vector<AsyncLogSink*>* gOpenSinks = new std::vector<AsyncLogSink*>;
+
+AsyncLogSink::AsyncLogSink()
+: fFD(-1), fOwnerPID(0), fIsStopped(true), fPutArea(PUTAREASIZE),
+  fAttachedStream(nullptr), fOriginalBuffer(nullptr)
+{
+    setp(fPutArea.data(), fPutArea.data() + fPutArea.size());
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+    Close();
+}
+
+bool AsyncLogSink::Open(std::string path)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    Start(fd);
+    return true;
+}
+
+void AsyncLogSink::OpenConsole()
+{
+    std::cout.flush();
+    fflush(stdout);
+    Start(dup(1));
+}
+
+void AsyncLogSink::Start(int fd)
+{
+    Close();
+
+    fFD = fd;
+    fOwnerPID = getpid();
+    fIsStopped = false;
+    fThread = std::thread(&AsyncLogSink::Run, this);
+
+    static bool isExitHandlerSet = (std::atexit(&AsyncLogSink::FlushAll) == 0);
+    static bool isForkHandlerSet = (pthread_atfork(nullptr, nullptr, &AsyncLogSink::DetachInChild) == 0);
+    (void)isExitHandlerSet; (void)isForkHandlerSet;
+
+    std::lock_guard<std::mutex> lock(*gOpenSinksMutex);
+    gOpenSinks->push_back(this);
+}
+
+void AsyncLogSink::Close()
+{
+    if (!IsOpen()) return;
+
+    if (fAttachedStream) {
+        fAttachedStream->flush();
+        fAttachedStream->rdbuf(fOriginalBuffer);
+        fAttachedStream = nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(*gOpenSinksMutex);
+        gOpenSinks->erase(std::remove(gOpenSinks->begin(), gOpenSinks->end(), this), gOpenSinks->end());
+    }
+
+    Drain();
+    {
+        std::lock_guard<std::mutex> lock(fBufferMutex);
+        fIsStopped = true;
+    }
+    fCondition.notify_one();
+    if (fThread.joinable()) fThread.join();
+    WriteOut();
+
+    close(fFD);
+    fFD = -1;
+}
+
+void AsyncLogSink::Attach(std::ostream& stream)
+{
+    stream.flush();
+    fAttachedStream = &stream;
+    fOriginalBuffer = stream.rdbuf(this);
+}
+
+void AsyncLogSink::Flush()
+{
+    Drain();
+    WriteOut();
+}
+
+int AsyncLogSink::overflow(int c)
+{
+    // closed in a forked child: discard
+    if (!IsOpen()) {
+        setp(fPutArea.data(), fPutArea.data() + fPutArea.size());
+        return traits_type::not_eof(c);
+    }
+
+    Drain();
+    if (c != traits_type::eof()) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int AsyncLogSink::sync()
+{
+    if (!IsOpen()) return 0;
+    Drain();
+    return 0;
+}
+
+void AsyncLogSink::Run()
+{
+    std::unique_lock<std::mutex> lock(fBufferMutex);
+    while (!fIsStopped) {
+        fCondition.wait_for(lock, FLUSHINTERVAL, [this]{ return fIsStopped || fBuffer.size() >= FLUSHSIZE; });
+        lock.unlock();
+        WriteOut();
+        lock.lock();
+    }
+}
+
+void AsyncLogSink::Drain()
+{
+    if (pptr() == pbase()) return;
+
+    bool isFull = false;
+    {
+        std::lock_guard<std::mutex> lock(fBufferMutex);
+        fBuffer.append(pbase(), pptr() - pbase());
+        isFull = fBuffer.size() >= FLUSHSIZE;
+    }
+    setp(fPutArea.data(), fPutArea.data() + fPutArea.size());
+
+    if (isFull) fCondition.notify_one();
+}
+
+void AsyncLogSink::WriteOut()
+{
+    // hold the write lock while swapping so that the output keeps its order
+    std::lock_guard<std::mutex> writeLock(fWriteMutex);
+    {
+        std::lock_guard<std::mutex> lock(fBufferMutex);
+        fWriteBuffer.swap(fBuffer);
+    }
+
+    const char* data = fWriteBuffer.data();
+    size_t nLeft = fWriteBuffer.size();
+    while (nLeft > 0 && fFD >= 0) {
+        ssize_t nWritten = write(fFD, data, nLeft);
+        if (nWritten < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        data += nWritten;
+        nLeft -= nWritten;
+    }
+    fWriteBuffer.clear();
+}
+
+void AsyncLogSink::DetachInChild()
+{
+    // the child has no writer thread, and the mutexes may have been held at fork,
+    // so let attached streams write directly and never touch the sinks
+    for (auto& sink: *gOpenSinks) {
+        if (sink->fAttachedStream) {
+            sink->fAttachedStream->rdbuf(sink->fOriginalBuffer);
+            sink->fAttachedStream = nullptr;
+        }
+        close(sink->fFD);
+        sink->fFD = -1;
+    }
+    new (gOpenSinksMutex) std::mutex;
+    gOpenSinks->clear();
+}
+
+void AsyncLogSink::FlushAll()
+{
+    std::lock_guard<std::mutex> lock(*gOpenSinksMutex);
+    for (auto& sink: *gOpenSinks)
+        if (sink->fOwnerPID == getpid()) sink->Flush();
+}
@@ -0,0 +1,107 @@
+/*******************************************
+*
+* @file AsyncLogSink.hh
+*
+* @brief Defines AsyncLogSink.
+*
+********************************************/
+
+#ifndef ASYNCLOGSINK_HH
+#define ASYNCLOGSINK_HH
+
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*******************************************
+*
+* @brief Buffered output sink written by a
+* background thread.
+*
+* @details Text written to the sink (directly
+* with AsyncLogSink::Write, or through an
+* \c std::ostream attached with
+* AsyncLogSink::Attach) is appended to a memory
+* buffer, which a background thread writes to
+* the file or console once it has grown large
+* or some time has passed. Flushing the stream,
+* e.g., by \c std::endl, only moves the text
+* to the buffer, so the caller never waits for
+* the console.
+*
+* The console sink writes to a copy of stdout
+* taken by AsyncLogSink::OpenConsole, so it is
+* not muted by SKIO::DisableConsoleOut.
+* Open sinks are flushed at normal exit,
+* including exits by \c pERROR messages.
+*
+* In forked children (e.g., the noise reader
+* and LOWFIT workers), attached streams are
+* restored to their original buffers, and the
+* sinks are closed without being written out.
+*
+********************************************/
+
+class AsyncLogSink : public std::streambuf
+{
+    public:
+        AsyncLogSink();
+        ~AsyncLogSink();
+
+        /**
+         * @brief Opens a file at \c path to write to.
+         * @return \c true if the file is opened.
+         */
+        bool Open(std::string path);
+        /**
+         * @brief Writes to the current stdout.
+         */
+        void OpenConsole();
+        /**
+         * @brief Writes out the buffer, stops the thread, and restores the attached stream.
+         */
+        void Close();
+        bool IsOpen() const { return fFD >= 0; }
+
+        /**
+         * @brief Redirects \c stream into the sink until AsyncLogSink::Close.
+         */
+        void Attach(std::ostream& stream);
+
+        void Write(const std::string& text) { sputn(text.data(), text.size()); }
+        /**
+         * @brief Writes out the buffer and waits until it is written.
+         */
+        void Flush();
+
+    protected:
+        int overflow(int c) override;
+        int sync() override;
+
+    private:
+        void Start(int fd);
+        void Run();
+        void Drain();
+        void WriteOut();
+
+        static void FlushAll();
+        static void DetachInChild();
+
+        int fFD, fOwnerPID;
+        bool fIsStopped;
+
+        std::vector<char> fPutArea;
+        std::string fBuffer, fWriteBuffer;
+        std::mutex fBufferMutex, fWriteMutex;
+        std::condition_variable fCondition;
+        std::thread fThread;
+
+        std::ostream* fAttachedStream;
+        std::streambuf* fOriginalBuffer;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <cmath>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <numeric>
 #include <string>
@@ -18,6 +19,107 @@
 std::default_random_engine c_ranGen;
 TRandom3 ranGen;
 
+namespace
+{
+    /** Maximum number of sorted runs that are merged instead of sorted from scratch */
+    const unsigned int MAXNMERGEDRUNS = 8;
+    /** Minimum number of elements to use the radix sort for */
+    const unsigned int MINRADIXSORTSIZE = 1024;
+
+    // unsigned integers whose order is the same as that of the floating point numbers
+    inline uint32_t GetRadixKey(float f)
+    {
+        uint32_t u; std::memcpy(&u, &f, sizeof(u));
+        return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+    }
+    inline uint64_t GetRadixKey(double d)
+    {
+        uint64_t u; std::memcpy(&u, &d, sizeof(u));
+        return (u & 0x8000000000000000ull) ? ~u : (u | 0x8000000000000000ull);
+    }
+
+    template <typename T>
+    void RadixSortIndex(const std::vector<T>& vec, std::vector<unsigned int>& index)
+    {
+        typedef decltype(GetRadixKey(T())) Key;
+        const unsigned int nElements = vec.size();
+
+        std::vector<std::pair<Key, unsigned int>> keys(nElements), buffer(nElements);
+        for (unsigned int i=0; i<nElements; i++)
+            keys[i] = std::make_pair(GetRadixKey(vec[i]), i);
+
+        // 8 bits per pass, from the least significant byte
+        for (unsigned int shift=0; shift<8*sizeof(Key); shift+=8) {
+            std::array<unsigned int, 257> offset{};
+            for (auto const& key: keys)
+                offset[((key.first >> shift) & 0xFF) + 1]++;
+
+            // skip the pass if all keys have the same byte
+            if (std::find(offset.begin(), offset.end(), nElements) != offset.end())
+                continue;
+
+            std::partial_sum(offset.begin(), offset.end(), offset.begin());
+            for (auto const& key: keys)
+                buffer[offset[(key.first >> shift) & 0xFF]++] = key;
+            keys.swap(buffer);
+        }
+
+        for (unsigned int i=0; i<nElements; i++)
+            index[i] = keys[i].second;
+    }
+
+    template <typename T>
+    void SortIndex(const std::vector<T>& vec, std::vector<unsigned int>& index)
+    {
+        const unsigned int nElements = vec.size();
+        index.resize(nElements);
+        std::iota(index.begin(), index.end(), 0);
+
+        // find the ends of the sorted runs
+        std::vector<unsigned int> runEnds;
+        for (unsigned int i=1; i<nElements && runEnds.size()<=MAXNMERGEDRUNS; i++)
+            if (vec[i] < vec[i-1]) runEnds.push_back(i);
+        runEnds.push_back(nElements);
+
+        auto lessThan = [&](unsigned int i, unsigned int j) { return vec[i] < vec[j]; };
+
+        if (runEnds.size() == 1)
+            return;
+        else if (runEnds.size() <= MAXNMERGEDRUNS) {
+            // merge neighboring runs until a single run is left
+            while (runEnds.size() > 1) {
+                std::vector<unsigned int> mergedRunEnds;
+                unsigned int runStart = 0;
+                for (unsigned int iRun=0; iRun<runEnds.size(); iRun+=2) {
+                    if (iRun+1 < runEnds.size()) {
+                        std::inplace_merge(index.begin()+runStart, index.begin()+runEnds[iRun],
+                                           index.begin()+runEnds[iRun+1], lessThan);
+                        runStart = runEnds[iRun+1];
+                    }
+                    else
+                        runStart = runEnds[iRun];
+                    mergedRunEnds.push_back(runStart);
+                }
+                runEnds.swap(mergedRunEnds);
+            }
+        }
+        else if (nElements >= MINRADIXSORTSIZE)
+            RadixSortIndex(vec, index);
+        else
+            std::sort(index.begin(), index.end(), lessThan);
+    }
+}
+
+void GetSortedIndex(const std::vector<float>& vec, std::vector<unsigned int>& index)
+{
+    SortIndex(vec, index);
+}
+
+void GetSortedIndex(const std::vector<double>& vec, std::vector<unsigned int>& index)
+{
+    SortIndex(vec, index);
+}
+
 float Sigmoid(const float x)
 {
     return 1 / (1 + exp(-x));
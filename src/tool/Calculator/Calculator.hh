@@ -11,7 +11,9 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <map>
 #include <vector>
 #include <stdlib.h>
@@ -272,6 +274,52 @@ void Shuffle(std::vector<T>& vec)
     std::shuffle(std::begin(vec), std::end(vec), c_ranGen);
 }
 
+/**
+ * @brief Counter-based random number generator.
+ * @details Returns the \c counter-th 64-bit random number of the stream \c key
+ * using the SplitMix64 mixing function. Since there is no internal state,
+ * independent streams (e.g., one per PMT) can be drawn in any order.
+ * @param key Stream key.
+ * @param counter Index of the number within the stream.
+ */
+inline uint64_t CounterHash(uint64_t key, uint64_t counter)
+{
+    uint64_t z = key + (counter + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Uniform random number in (0, 1) from the counter-based generator.
+ * @see CounterHash
+ */
+inline double CounterUniform(uint64_t key, uint64_t counter)
+{
+    return ((CounterHash(key, counter) >> 11) + 0.5) * (1. / 9007199254740992.);
+}
+
+/**
+ * @brief Exponential random number with mean \c mean from the counter-based generator.
+ * @see CounterHash
+ */
+inline double CounterExp(uint64_t key, uint64_t counter, double mean)
+{
+    return -mean * std::log(CounterUniform(key, counter));
+}
+
+/**
+ * @brief Gaussian random number from the counter-based generator (Box-Muller).
+ * @details Uses two consecutive counters, \c counter and \c counter+1.
+ * @see CounterHash
+ */
+inline double CounterGaus(uint64_t key, uint64_t counter, double mean, double sigma)
+{
+    double u1 = CounterUniform(key, counter);
+    double u2 = CounterUniform(key, counter+1);
+    return mean + sigma * std::sqrt(-2.*std::log(u1)) * std::cos(2.*M_PI*u2);
+}
+
 /**
  * @brief Pick a random subdirectory from a given path.
  * @param dirPath The given directory path in string.
@@ -328,6 +376,62 @@ std::vector<unsigned int> GetRangeIndex(const std::vector<T>& sortedVec, T low,
     return vIndex;
 }
 
+/**
+ * @brief Get the indices that sort a given vector in ascending order.
+ * @details The sort adapts to the input: an already sorted vector costs a single scan,
+ * a concatenation of a few sorted runs is merged run by run,
+ * and a large unsorted vector is sorted by an LSD radix sort on the bit patterns of the elements.
+ * Indices of equal elements may be in any order.
+ * @param vec The input vector.
+ * @param index The output vector of indices, such that \c vec[index[i]] is the i-th smallest element.
+ */
+void GetSortedIndex(const std::vector<float>& vec, std::vector<unsigned int>& index);
+void GetSortedIndex(const std::vector<double>& vec, std::vector<unsigned int>& index);
+
+/**
+ * @brief Returns the maximum number of elements within any time window of a given width.
+ * @details Windows are slid over the elements in O(N), and every window ends at an element,
+ * so the result is not smaller than the largest bin count of any fixed binning with the same width.
+ * @param begin The first element. Elements in [begin, end) should be sorted in time.
+ * @param end The end of the elements.
+ * @param getT A function that returns the time of an element.
+ * @param tWidth The width of the time window.
+ * @param min Only the elements with time within (min, max) are counted.
+ * @param max Only the elements with time within (min, max) are counted.
+ * @return The maximum number of elements within a time window of width \c tWidth.
+ */
+template <typename Iterator, typename TimeFunc>
+int GetMaxNInWindow(Iterator begin, Iterator end, TimeFunc getT, float tWidth,
+                    float min=-std::numeric_limits<float>::infinity(),
+                    float max=std::numeric_limits<float>::infinity())
+{
+    while (begin != end && !(min < getT(*begin))) ++begin;
+
+    int maxN = 0, nInWindow = 0;
+    Iterator windowStart = begin;
+    for (Iterator it=begin; it!=end && getT(*it) < max; ++it) {
+        nInWindow++;
+        while (!(getT(*it) - getT(*windowStart) < tWidth)) {
+            ++windowStart;
+            nInWindow--;
+        }
+        if (nInWindow > maxN) maxN = nInWindow;
+    }
+
+    return maxN;
+}
+
+/**
+ * @brief Returns the maximum number of elements of a sorted vector within any window of width \c tWidth.
+ * @see GetMaxNInWindow(Iterator, Iterator, TimeFunc, float, float, float)
+ */
+inline int GetMaxNInWindow(const std::vector<float>& sortedVec, float tWidth,
+                           float min=-std::numeric_limits<float>::infinity(),
+                           float max=std::numeric_limits<float>::infinity())
+{
+    return GetMaxNInWindow(sortedVec.begin(), sortedVec.end(), [](float t){ return t; }, tWidth, min, max);
+}
+
 /**
  * @brief Histogram a given vector of float.
  * @param vec The input vector of float to histogram.
@@ -3,6 +3,8 @@
 
 #include "Printer.hh"
 
+Verbosity Printer::fMaxVerbosity = pDEBUG;
+
 Printer::Printer(std::string className, Verbosity verbose):
 fClassName(className), fVerbosity(verbose) {}
 Printer::~Printer() {}
@@ -25,7 +27,7 @@ void Printer::PrintTag(Verbosity vType)
 
 void Printer::Print(TString msg, Verbosity vType, bool newLine)
 {
-    if (vType <= fVerbosity) {
+    if (IsPrinted(vType)) {
         PrintTag(vType);
         if (vType == pERROR) {
             std::cerr << "\033[m " << msg;
@@ -40,6 +42,8 @@ void Printer::Print(TString msg, Verbosity vType, bool newLine)
 
 void Printer::PrintBlock(TString line, BlockSize size, Verbosity vType, bool newLine)
 {
+    if (!IsPrinted(vType)) return;
+
     std::string blockWall(size, '=');
     TString coloredLine = "\033[1;36m" + line + "\033[m";
 
@@ -102,9 +102,23 @@ class Printer
 
         inline void SetVerbosity(Verbosity verbose) { fVerbosity = verbose; }
 
+        /**
+         * @brief Returns \c true if a message of type \c vType will be printed.
+         * @details Use this to skip formatting messages that will not be printed, e.g.,
+         * `if (msg.IsPrinted(pDEBUG)) msg.Print(Form(...), pDEBUG);`.
+         */
+        inline bool IsPrinted(Verbosity vType) const { return vType <= fVerbosity && vType <= fMaxVerbosity; }
+
+        /**
+         * @brief Caps the verbosity of all Printer instances, e.g., to pWARNING with \c -quiet.
+         */
+        static void SetMaxVerbosity(Verbosity verbose) { fMaxVerbosity = verbose; }
+
     private:
         std::string  fClassName;
         Verbosity    fVerbosity;
+
+        static Verbosity fMaxVerbosity;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <sys/resource.h>
+
+#include <TTree.h>
+
+#include "Calculator.hh"
+#include "Profiler.hh"
+
+Profiler::Profiler(Verbosity verbose)
+: fIsEnabled(false), fHasStarted(false), fDigest(0), fMsg("Profiler", verbose)
+{
+    fEventTime.fill(Clock::duration::zero());
+    fEventCount.fill(0);
+    fEventTimeMs.fill(0);
+    fEventCountOut.fill(0);
+    fTotalCount.fill(0);
+}
+
+void Profiler::EndEvent()
+{
+    if (!fIsEnabled) return;
+
+    auto now = Clock::now();
+    if (!fHasStarted) {
+        // the first event is counted from its earliest stage
+        fRunStartTime = now;
+        for (int iStage=0; iStage<nProfileStages; iStage++)
+            fRunStartTime -= fEventTime[iStage];
+        fHasStarted = true;
+    }
+    fLastEventTime = now;
+
+    for (int iStage=0; iStage<nProfileStages; iStage++) {
+        fEventTimeMs[iStage] = std::chrono::duration<float, std::milli>(fEventTime[iStage]).count();
+        fStageTimeMs[iStage].push_back(fEventTimeMs[iStage]);
+        fEventTime[iStage] = Clock::duration::zero();
+    }
+    for (int iCounter=0; iCounter<nProfileCounters; iCounter++) {
+        fEventCountOut[iCounter] = fEventCount[iCounter];
+        fTotalCount[iCounter] += fEventCount[iCounter];
+        fEventCount[iCounter] = 0;
+    }
+
+    FillTree();
+}
+
+void Profiler::MakeBranches()
+{
+    if (fIsOutputTreeSet) {
+        for (int iStage=0; iStage<nProfileStages; iStage++)
+            fOutputTree->Branch(GetStageName(ProfileStage(iStage)), &fEventTimeMs[iStage]);
+        for (int iCounter=0; iCounter<nProfileCounters; iCounter++)
+            fOutputTree->Branch(GetCounterName(ProfileCounter(iCounter)), &fEventCountOut[iCounter]);
+    }
+}
+
+static float GetQuantile(std::vector<float> vec, float p)
+{
+    unsigned int i = std::min((unsigned int)(p*vec.size()), (unsigned int)vec.size()-1);
+    std::nth_element(vec.begin(), vec.begin()+i, vec.end());
+    return vec[i];
+}
+
+void Profiler::PrintSummary()
+{
+    if (!fIsEnabled || fStageTimeMs[0].empty()) return;
+
+    unsigned int nEvents = fStageTimeMs[0].size();
+    float runTime = std::chrono::duration<float>(fLastEventTime - fRunStartTime).count();
+
+    std::cout << "\n";
+    fMsg.Print(Form("Processing time per event (%d events, %3.2f s):", nEvents, runTime));
+    std::cout << "\n\033[4m" << std::left << std::setw(20) << "Stage"
+              << std::right << std::setw(12) << "Mean (ms)" << std::setw(12) << "P50 (ms)"
+              << std::setw(12) << "P99 (ms)" << std::setw(12) << "Total (s)" << "\033[0m\n";
+    for (int iStage=0; iStage<nProfileStages; iStage++) {
+        auto const& stageTime = fStageTimeMs[iStage];
+        std::cout << std::left << std::setw(20) << GetStageName(ProfileStage(iStage)) << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << GetMean(stageTime)
+                  << std::setw(12) << GetQuantile(stageTime, 0.5)
+                  << std::setw(12) << GetQuantile(stageTime, 0.99)
+                  << std::setw(12) << GetSum(stageTime)*1e-3 << "\n";
+    }
+    std::cout << std::defaultfloat << "\n";
+
+    if (runTime > 0) {
+        fMsg.Print(Form("Events: %3.2f /s, candidates: %3.2f /s, hits: %3.2e /s, vertex fits: %3.2f /s",
+                        nEvents/runTime, fTotalCount[cCandidates]/runTime,
+                        fTotalCount[cHits]/runTime, fTotalCount[cVertexFits]/runTime));
+    }
+    fMsg.Print(Form("Peak RSS: %3.1f MB", GetPeakRSS()));
+}
+
+void Profiler::WriteJSON(std::string path, const std::vector<std::pair<std::string, std::string>>& info)
+{
+    if (!fIsEnabled || fStageTimeMs[0].empty()) return;
+
+    std::ofstream file(path);
+    if (!file) {
+        fMsg.Print("Could not open " + path + " to write the profile summary!", pWARNING);
+        return;
+    }
+
+    unsigned int nEvents = fStageTimeMs[0].size();
+    float runTime = std::chrono::duration<float>(fLastEventTime - fRunStartTime).count();
+    float rate = runTime > 0 ? 1./runTime : 0;
+
+    file << "{\n";
+    for (auto const& pair: info)
+        file << Form("  \"%s\": \"%s\",\n", pair.first.c_str(), pair.second.c_str());
+    file << Form("  \"events\": %d,\n", nEvents);
+    file << Form("  \"run_time_s\": %.4f,\n", runTime);
+    file << Form("  \"events_per_s\": %.4f,\n", nEvents*rate);
+    file << Form("  \"candidates_per_s\": %.4f,\n", fTotalCount[cCandidates]*rate);
+    file << Form("  \"hits_per_s\": %.4e,\n", fTotalCount[cHits]*rate);
+    file << Form("  \"peak_rss_mb\": %.1f,\n", GetPeakRSS());
+    file << Form("  \"output_digest\": \"%016llx\",\n", (unsigned long long)fDigest);
+
+    file << "  \"counters\": {";
+    for (int iCounter=0; iCounter<nProfileCounters; iCounter++)
+        file << Form("%s\"%s\": %ld", (iCounter ? ", " : ""), GetCounterName(ProfileCounter(iCounter)), fTotalCount[iCounter]);
+    file << "},\n";
+
+    file << "  \"stages\": {\n";
+    for (int iStage=0; iStage<nProfileStages; iStage++) {
+        auto const& stageTime = fStageTimeMs[iStage];
+        file << Form("    \"%s\": {\"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, \"total_s\": %.4f}%s\n",
+                     GetStageName(ProfileStage(iStage)), GetMean(stageTime),
+                     GetQuantile(stageTime, 0.5), GetQuantile(stageTime, 0.99), GetSum(stageTime)*1e-3,
+                     (iStage < nProfileStages-1 ? "," : ""));
+    }
+    file << "  }\n}\n";
+
+    fMsg.Print("Profile summary written to " + path);
+}
+
+float Profiler::GetPeakRSS()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.; // ru_maxrss is in kB on Linux
+}
+
+const char* Profiler::GetStageName(ProfileStage stage)
+{
+    static const char* names[nProfileStages] = {"ReadEvent", "AddHits", "AddNoise", "PrepareEventHits", "SearchCandidates",
+                                                "VertexFit", "FindFeatures", "NNInference", "Classify", "FillTrees"};
+    return names[stage];
+}
+
+const char* Profiler::GetCounterName(ProfileCounter counter)
+{
+    static const char* names[nProfileCounters] = {"NHits", "NCandidates", "NVertexFits"};
+    return names[counter];
+}
@@ -0,0 +1,158 @@
+/**
+ * @file Profiler.hh
+ */
+
+#ifndef PROFILER_HH
+#define PROFILER_HH
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TreeOut.hh"
+#include "Printer.hh"
+#include "Calculator.hh"
+
+/**
+ * @brief Stages of event processing timed by Profiler.
+ * @details Stages may be nested, e.g., ::sNNInference and ::sClassify
+ * are also counted in ::sFindFeatures.
+ */
+enum ProfileStage
+{
+    sReadEvent,
+    sAddHits,
+    sAddNoise,
+    sPrepareEventHits,
+    sSearchCandidates,
+    sVertexFit,
+    sFindFeatures,
+    sNNInference,
+    sClassify,
+    sFillTrees,
+    nProfileStages
+};
+
+/**
+ * @brief Event counters kept by Profiler.
+ */
+enum ProfileCounter
+{
+    cHits,       ///< number of ID hits processed
+    cCandidates, ///< number of delayed candidates found
+    cVertexFits, ///< number of delayed vertex fits
+    nProfileCounters
+};
+
+/**
+ * @brief Per-stage timer and counters of event processing.
+ *
+ * @details Time spent in each ::ProfileStage is accumulated between
+ * Profiler::Start and Profiler::Stop (or by a ScopedTimer) until Profiler::EndEvent,
+ * which saves the event record to the output tree, if set,
+ * and keeps it for the end-of-run summary (Profiler::PrintSummary, Profiler::WriteJSON).
+ * All methods return immediately if the profiler is disabled.
+ */
+class Profiler : public TreeOut
+{
+    public:
+        Profiler(Verbosity verbose=pDEFAULT);
+
+        void SetEnabled(bool b) { fIsEnabled = b; }
+        bool IsEnabled() const { return fIsEnabled; }
+
+        inline void Start(ProfileStage stage)
+        {
+            if (fIsEnabled) fStartTime[stage] = Clock::now();
+        }
+        inline void Stop(ProfileStage stage)
+        {
+            if (fIsEnabled) fEventTime[stage] += Clock::now() - fStartTime[stage];
+        }
+        inline void Count(ProfileCounter counter, int n=1)
+        {
+            if (fIsEnabled) fEventCount[counter] += n;
+        }
+        /**
+         * @brief Folds the bits of \c value into the digest of the physics output.
+         * @details The digest changes if any folded value or their order changes,
+         * so two runs with the same input can be checked for identical output.
+         */
+        inline void AddToDigest(float value)
+        {
+            if (!fIsEnabled) return;
+            uint32_t bits; std::memcpy(&bits, &value, sizeof(bits));
+            fDigest = CounterHash(fDigest, bits);
+        }
+        uint64_t GetDigest() const { return fDigest; }
+
+        /**
+         * @brief Closes the record of the current event and fills the output tree.
+         */
+        void EndEvent();
+
+        void MakeBranches();
+
+        /**
+         * @brief Prints the mean, median, and 99th percentile time per event of each stage,
+         * and the candidate and hit throughput over all events.
+         */
+        void PrintSummary();
+        /**
+         * @brief Writes the summary of Profiler::PrintSummary, the peak RSS, and the output digest
+         * to a JSON file, along with the key-value pairs in \c info.
+         */
+        void WriteJSON(std::string path, const std::vector<std::pair<std::string, std::string>>& info);
+
+        /**
+         * @brief Returns the peak resident set size of the process in MB.
+         */
+        static float GetPeakRSS();
+
+        void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
+
+        static const char* GetStageName(ProfileStage stage);
+        static const char* GetCounterName(ProfileCounter counter);
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        bool fIsEnabled;
+
+        std::array<Clock::time_point, nProfileStages> fStartTime;
+        std::array<Clock::duration, nProfileStages> fEventTime;
+        std::array<int, nProfileCounters> fEventCount;
+
+        // tree branches
+        std::array<float, nProfileStages> fEventTimeMs;
+        std::array<int, nProfileCounters> fEventCountOut;
+
+        // all events
+        std::array<std::vector<float>, nProfileStages> fStageTimeMs;
+        std::array<long, nProfileCounters> fTotalCount;
+        Clock::time_point fRunStartTime, fLastEventTime;
+        bool fHasStarted;
+        uint64_t fDigest;
+
+        Printer fMsg;
+};
+
+/**
+ * @brief Times a ::ProfileStage from construction to destruction.
+ */
+class ScopedTimer
+{
+    public:
+        ScopedTimer(Profiler& profiler, ProfileStage stage)
+        : fProfiler(profiler), fStage(stage) { fProfiler.Start(fStage); }
+        ~ScopedTimer() { fProfiler.Stop(fStage); }
+
+    private:
+        Profiler& fProfiler;
+        ProfileStage fStage;
+};
+
+#endif
@@ -1,3 +1,6 @@
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <skheadC.h>
 #undef MAXHWSK
 #include <fortran_interface.h>
@@ -21,8 +24,9 @@ int SKIO::fSKGeometry = 5;
 int SKIO::fSKBadChOption = 0;
 int SKIO::fRefRunNo = 85619;
 
-int SKIO::fTmpOut = 0;
-int SKIO::fBackupOut = 0;
+int SKIO::fTmpOut = -1;
+int SKIO::fBackupOut = -1;
+int SKIO::fMuteDepth = 0;
 bool SKIO::fVerbose = false;
 
 SKIO::SKIO()
@@ -419,22 +423,24 @@ float SKIO::GetMCTriggerOffset(FileFormat format)
 
 void SKIO::DisableConsoleOut()
 {
-    if (!fVerbose) {
-        fflush(stdout);
+    if (fVerbose || fMuteDepth++ > 0) return;
+
+    // open /dev/null and save the original stdout only once
+    if (fTmpOut < 0) {
         fBackupOut = dup(1);
-        FILE* f = fopen("/dev/null", "w");
-        fTmpOut = fileno(f);
-        dup2(fTmpOut, 1);
-        fclose(f);
+        fTmpOut = open("/dev/null", O_WRONLY);
     }
+    if (fTmpOut < 0 || fBackupOut < 0) return;
+
+    fflush(stdout);
+    dup2(fTmpOut, 1);
 }
 
 void SKIO::EnableConsoleOut()
 {
-    if (!fVerbose)
-    {
-        fflush(stdout);
-        dup2(fBackupOut, 1);
-        close(fBackupOut);
-    }
+    if (fVerbose || fMuteDepth == 0 || --fMuteDepth > 0) return;
+    if (fTmpOut < 0 || fBackupOut < 0) return;
+
+    fflush(stdout);
+    dup2(fBackupOut, 1);
 }
\ No newline at end of file
@@ -100,6 +100,12 @@ class SKIO
 
         static void SetVerbose(bool verbose) { fVerbose = verbose; }
         static bool GetVerbose() { return fVerbose; }
+        /**
+         * @brief Redirects stdout to /dev/null unless verbose, e.g., to mute Fortran routines.
+         * @details Calls can be nested: stdout is restored by the EnableConsoleOut call
+         * that matches the outermost DisableConsoleOut. /dev/null and the original stdout
+         * are opened once and kept, so muting costs a single \c dup2 per outermost call.
+         */
         static void DisableConsoleOut();
         static void EnableConsoleOut();
 
@@ -123,6 +129,7 @@ class SKIO
 
         static int fTmpOut;
         static int fBackupOut;
+        static int fMuteDepth;
         static bool fVerbose;
 
         Printer fMsg;
@@ -0,0 +1,210 @@
+#include <fstream>
+#include <sstream>
+
+#include <skheadC.h>
+#include <skbadcC.h>
+#undef MAXPM
+#undef MAXPMA
+#include <geotnkC.h>
+
+#include "Calculator.hh"
+#include "SKIO.hh"
+#include "SyntheticEventGenerator.hh"
+
+// physics constants
+static const float NHCAPTUREENERGY  = 2.22;   // [MeV]
+static const float NGDCAPTUREENERGY = 7.94;   // [MeV], summed cascade energy
+static const float NHCAPTURETIME    = 204.8;  // [us], pure water
+static const float NGDCAPTURETIME   = 115.;   // [us], SK-Gd
+static const float MUONLIFETIME     = 2.197;  // [us]
+static const float MICHELENDPOINT   = 52.83;  // [MeV]
+static const float PMTTIMERES       = 3.;     // [ns]
+
+SyntheticEventGenerator::SyntheticEventGenerator(Verbosity verbose)
+: fNEvents(100), fCurrentEventID(0), fSeed(1), fSKGeometry(6),
+  fDarkRate(4.5), fTStart(0), fTEnd(536e3), fPromptTime(1e3),
+  NNEUTRONS(2), GDFRACTION(0), NDECAYE(0.5), HITSPERMEV(6), NPROMPTHITS(2000),
+  fPMTTablePath(GetENV("NTAGLIBPATH") + "/bench/PMTGeometry.dat"),
+  fMsg("SyntheticEventGenerator", verbose)
+{}
+
+SyntheticEventGenerator::~SyntheticEventGenerator() {}
+
+void SyntheticEventGenerator::ApplySettings(Store& settings)
+{
+    auto pmtTablePath = settings.GetString("pmt_table", "default");
+    if (pmtTablePath != "default") fPMTTablePath = pmtTablePath;
+
+    fNEvents    = settings.GetInt("NSYNTHEVENTS", fNEvents);
+    fSeed       = settings.GetInt("SYNTHSEED", fSeed);
+    fSKGeometry = settings.GetInt("SKGEOMETRY", fSKGeometry);
+    fDarkRate   = settings.GetFloat("SYNTHDARKRATE", fDarkRate);
+    NNEUTRONS   = settings.GetFloat("SYNTHNNEUTRONS", NNEUTRONS);
+    GDFRACTION  = settings.GetFloat("SYNTHGDFRACTION", GDFRACTION);
+    NDECAYE     = settings.GetFloat("SYNTHNDECAYE", NDECAYE);
+    HITSPERMEV  = settings.GetFloat("SYNTHHITSPERMEV", HITSPERMEV);
+    NPROMPTHITS = settings.GetInt("SYNTHPROMPTNHITS", NPROMPTHITS);
+
+    if (settings.GetBool("debug", false)) fMsg.SetVerbosity(pDEBUG);
+}
+
+void SyntheticEventGenerator::DumpSettings()
+{
+    fMsg.PrintBlock("SyntheticEventGenerator settings");
+    fMsg.Print(Form("PMT table: %s (%d PMTs)", fPMTTablePath.c_str(), GetNPMTs()));
+    fMsg.Print(Form("Number of events: %d (seed: %d)", fNEvents, fSeed));
+    fMsg.Print(Form("Dark rate: %3.2f kHz", fDarkRate));
+    fMsg.Print(Form("Mean number of neutrons: %3.2f (Gd capture fraction: %3.2f)", NNEUTRONS, GDFRACTION));
+    fMsg.Print(Form("Mean number of decay electrons: %3.2f", NDECAYE));
+    fMsg.Print(Form("Prompt hits: %d, hits per MeV: %3.2f", NPROMPTHITS, HITSPERMEV));
+}
+
+void SyntheticEventGenerator::OpenFile()
+{
+    if (!ReadPMTTable(fPMTTablePath))
+        fMsg.Print("Could not read PMT table " + fPMTTablePath + ", use -pmt_table to set its path.", pERROR);
+
+    // SK geometry is normally read from the input file
+    skheadg_.sk_geometry = fSKGeometry;
+}
+
+bool SyntheticEventGenerator::ReadPMTTable(std::string path)
+{
+    std::ifstream file(path);
+    if (!file) return false;
+
+    fPMTPositions.clear();
+    fPMTDarkRates.clear();
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream stream(line);
+        int cableID; float x, y, z, darkRate;
+        if (!(stream >> cableID >> x >> y >> z) || cableID < 1 || cableID > MAXPM) continue;
+        if (!(stream >> darkRate)) darkRate = fDarkRate;
+
+        if ((int)fPMTPositions.size() < cableID) {
+            fPMTPositions.resize(cableID);
+            fPMTDarkRates.resize(cableID, 0);
+        }
+        fPMTPositions[cableID-1] = TVector3(x, y, z);
+        fPMTDarkRates[cableID-1] = darkRate;
+    }
+
+    // fill the commons that the hit cluster functions use
+    SKIO::ResetBadChannels();
+    double rateSum = 0;
+    for (int iPMT=0; iPMT<MAXPM; iPMT++) {
+        float darkRate = iPMT < GetNPMTs() ? fPMTDarkRates[iPMT] : 0;
+        if (iPMT < GetNPMTs()) {
+            geopmt_.xyzpm[iPMT][0] = fPMTPositions[iPMT].x();
+            geopmt_.xyzpm[iPMT][1] = fPMTPositions[iPMT].y();
+            geopmt_.xyzpm[iPMT][2] = fPMTPositions[iPMT].z();
+        }
+        comdark_.dark_rate[iPMT] = darkRate;
+        rateSum += darkRate;
+    }
+    comdark_.dark_ave = GetNPMTs() ? rateSum / GetNPMTs() : 0;
+
+    return GetNPMTs() > 0;
+}
+
+int SyntheticEventGenerator::ReadEvent(int eventID)
+{
+    if (eventID < 1 || eventID > fNEvents)
+        return mReadEOF;
+
+    fCurrentEventID = eventID;
+    fRandom.SetSeed(CounterHash(fSeed, eventID) | 1);
+
+    fHits.Clear();
+    fTaggables.Clear();
+
+    fPromptVertex = GetRandomVertex(RINTK-200, ZPINTK-200);
+    fTaggables.SetPromptVertex(fPromptVertex);
+
+    AddDarkNoise(fHits, fTStart, fTEnd);
+    AddHitCluster(fHits, fPromptVertex, fPromptTime, NPROMPTHITS);
+
+    // decay electrons
+    int nDecayE = fRandom.Poisson(NDECAYE);
+    for (int iDecayE=0; iDecayE<nDecayE; iDecayE++) {
+        float time = fPromptTime + fRandom.Exp(MUONLIFETIME*1e3);
+        float energy = GetMichelEnergy();
+        auto vertex = GetDisplacedVertex(fPromptVertex, 50);
+        AddHitCluster(fHits, vertex, time, fRandom.Poisson(energy*HITSPERMEV));
+        // taggable times are relative to the trigger, as in MC
+        fTaggables.Append(Taggable(typeE, (time-fPromptTime)*1e-3, energy, vertex));
+    }
+
+    // neutron captures on Gd with probability GDFRACTION, otherwise on H
+    int nNeutrons = fRandom.Poisson(NNEUTRONS);
+    for (int iNeutron=0; iNeutron<nNeutrons; iNeutron++) {
+        bool isGdCapture = fRandom.Uniform() < GDFRACTION;
+        float time = fPromptTime + fRandom.Exp((isGdCapture ? NGDCAPTURETIME : NHCAPTURETIME)*1e3);
+        float energy = isGdCapture ? NGDCAPTUREENERGY : NHCAPTUREENERGY;
+        auto vertex = GetDisplacedVertex(fPromptVertex, 100);
+        if (time > fTEnd) continue;
+        AddHitCluster(fHits, vertex, time, fRandom.Poisson(energy*HITSPERMEV));
+        fTaggables.Append(Taggable(typeN, (time-fPromptTime)*1e-3, energy, vertex));
+    }
+
+    fHits.Sort();
+    fTaggables.Sort();
+
+    fMsg.Print(Form("Synthetic event %d: %d hits, %d decay electrons, %d taggable neutrons",
+                    eventID, fHits.GetSize(), nDecayE, fTaggables.GetSize()-nDecayE), pDEBUG);
+
+    return mReadOK;
+}
+
+void SyntheticEventGenerator::AddDarkNoise(PMTHitCluster& hits, float tStart, float tEnd)
+{
+    float tWidth = tEnd - tStart;
+
+    for (int iPMT=0; iPMT<GetNPMTs(); iPMT++) {
+        int nNoiseHits = fRandom.Poisson(fPMTDarkRates[iPMT] * tWidth * 1e-6);
+        for (int iHit=0; iHit<nNoiseHits; iHit++) {
+            float q = std::abs(fRandom.Gaus(1, 0.7));
+            hits.Append(PMTHit(tStart + fRandom.Uniform(tWidth), q, iPMT+1, 2/* in-gate */));
+        }
+    }
+}
+
+void SyntheticEventGenerator::AddHitCluster(PMTHitCluster& hits, const TVector3& vertex, float t, int nHits)
+{
+    for (int iHit=0; iHit<nHits; iHit++) {
+        int iPMT = fRandom.Integer(GetNPMTs());
+        float tof = (fPMTPositions[iPMT] - vertex).Mag() / NTagConstant::C_WATER;
+        float q = std::abs(fRandom.Gaus(1, 0.7));
+        hits.Append(PMTHit(t + tof + fRandom.Gaus(0, PMTTIMERES), q, iPMT+1, 2/* in-gate */));
+    }
+}
+
+TVector3 SyntheticEventGenerator::GetRandomVertex(float rMax, float zMax)
+{
+    float r = rMax * std::sqrt(fRandom.Uniform());
+    float phi = fRandom.Uniform(2*M_PI);
+    return TVector3(r*std::cos(phi), r*std::sin(phi), fRandom.Uniform(-zMax, zMax));
+}
+
+TVector3 SyntheticEventGenerator::GetDisplacedVertex(const TVector3& vertex, float sigma)
+{
+    TVector3 displaced;
+    do {
+        displaced = vertex + TVector3(fRandom.Gaus(0, sigma), fRandom.Gaus(0, sigma), fRandom.Gaus(0, sigma));
+    } while (displaced.Perp() > RINTK || std::abs(displaced.z()) > ZPINTK);
+    return displaced;
+}
+
+float SyntheticEventGenerator::GetMichelEnergy()
+{
+    // Michel spectrum dN/dx ~ x^2 (3 - 2x), x = E/E_max, maximum 1 at x = 1
+    float x;
+    do {
+        x = fRandom.Uniform();
+    } while (fRandom.Uniform() > x*x*(3-2*x));
+    return x * MICHELENDPOINT;
+}
@@ -0,0 +1,126 @@
+/*******************************************
+*
+* @file SyntheticEventGenerator.hh
+*
+* @brief Defines SyntheticEventGenerator.
+*
+********************************************/
+
+#ifndef SYNTHETICEVENTGENERATOR_HH
+#define SYNTHETICEVENTGENERATOR_HH
+
+#include <string>
+#include <vector>
+
+#include <TRandom3.h>
+#include <TVector3.h>
+
+#include "Store.hh"
+#include "Printer.hh"
+#include "PMTHitCluster.hh"
+#include "TaggableCluster.hh"
+
+/*******************************************
+*
+* @brief Generates SK-like events in place of
+* input files, as a stand-in for the reading
+* role of SKIO.
+*
+* @details Each event consists of dark noise
+* hits over the 536 us AFT-combined window,
+* a prompt hit cluster at the trigger time
+* (1 us), and hit clusters of neutron captures
+* on H or Gd and decay electrons at known
+* vertices and times, which are kept as the
+* true TaggableCluster of the event.
+*
+* PMT positions and optional per-PMT dark rates
+* are read from a PMT table such as
+* bench/PMTGeometry.dat, which also fills the
+* geometry, dark rate and bad channel commons,
+* so no SK data files are needed.
+*
+* Events are seeded by the event ID, so
+* SyntheticEventGenerator::ReadEvent gives
+* the same event regardless of the read order.
+*
+* @see EventNTagManager::ProcessSyntheticEvent
+*
+********************************************/
+
+class SyntheticEventGenerator
+{
+    public:
+        SyntheticEventGenerator(Verbosity verbose=pDEFAULT);
+        ~SyntheticEventGenerator();
+
+        void ApplySettings(Store& settings);
+        void DumpSettings();
+
+        /**
+         * @brief Reads the PMT table set by the option \c pmt_table.
+         */
+        void OpenFile();
+        /**
+         * @brief Reads PMT positions and dark rates from a PMT table.
+         * @details Each line of the table has a cable ID, x, y, z [cm], and optionally a dark rate [kHz].
+         * PMTs without a dark rate in the table use the rate set by SetDarkRate.
+         * @return \c true if at least one PMT is read.
+         */
+        bool ReadPMTTable(std::string path);
+
+        /**
+         * @brief Generates the event \c eventID.
+         * @return \c mReadOK, or \c mReadEOF if \c eventID is out of range.
+         */
+        int ReadEvent(int eventID);
+        int GetNumberOfEvents() const { return fNEvents; }
+        int GetCurrentEventID() const { return fCurrentEventID; }
+
+        const PMTHitCluster& GetHits() const { return fHits; }
+        const TaggableCluster& GetTaggables() const { return fTaggables; }
+        const TVector3& GetPromptVertex() const { return fPromptVertex; }
+        float GetPromptTime() const { return fPromptTime; }
+        int GetNPMTs() const { return fPMTPositions.size(); }
+
+        void SetNumberOfEvents(int nEvents) { fNEvents = nEvents; }
+        void SetDarkRate(float darkRate) { fDarkRate = darkRate; }
+        void SetSeed(int seed) { fSeed = seed; fRandom.SetSeed(seed); }
+        void SetVerbosity(Verbosity verbose) { fMsg.SetVerbosity(verbose); }
+
+        /**
+         * @brief Appends dark noise hits of all PMTs in [\c tStart, \c tEnd] (ns) to \c hits.
+         * @note Hits are appended PMT by PMT, so \c hits should be sorted afterwards.
+         */
+        void AddDarkNoise(PMTHitCluster& hits, float tStart, float tEnd);
+        /**
+         * @brief Appends \c nHits hits of random PMTs that see light from a point source
+         * at \c vertex emitted at \c t (ns) to \c hits.
+         */
+        void AddHitCluster(PMTHitCluster& hits, const TVector3& vertex, float t, int nHits);
+
+    private:
+        TVector3 GetRandomVertex(float rMax, float zMax);
+        TVector3 GetDisplacedVertex(const TVector3& vertex, float sigma);
+        float GetMichelEnergy();
+
+        std::vector<TVector3> fPMTPositions;
+        std::vector<float> fPMTDarkRates; // [kHz]
+
+        int fNEvents, fCurrentEventID, fSeed, fSKGeometry;
+        float fDarkRate;           // [kHz]
+        float fTStart, fTEnd;      // [ns]
+        float fPromptTime;         // [ns]
+        float NNEUTRONS, GDFRACTION, NDECAYE, HITSPERMEV;
+        int NPROMPTHITS;
+        std::string fPMTTablePath;
+
+        PMTHitCluster fHits;
+        TaggableCluster fTaggables;
+        TVector3 fPromptVertex;
+
+        TRandom3 fRandom;
+        Printer fMsg;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TChain.h"
+
+#include "NTagGlobal.hh"
+#include "TrainingDataset.hh"
+
+static const char DATASETMAGIC[8] = "NTAGDS1";
+static const size_t HEADERALIGNMENT = 64;
+
+TrainingDataset::TrainingDataset(Verbosity verbose)
+: fMappedData(nullptr), fMappedSize(0), fNRows(0), fMsg("TrainingDataset", verbose)
+{}
+
+TrainingDataset::~TrainingDataset()
+{
+    Close();
+}
+
+long TrainingDataset::Export(std::string inFilePath, std::string outFilePath, const std::vector<std::string>& features)
+{
+    TChain chain("ntag");
+    chain.Add(inFilePath.c_str());
+
+    // read only the features and the branches for the signal/background selection
+    std::vector<std::string> branchNames = features;
+    for (auto const& name: {"Label", "SignalRatio"})
+        if (std::find(branchNames.begin(), branchNames.end(), name) == branchNames.end())
+            branchNames.push_back(name);
+
+    std::vector<std::vector<float>*> branches(branchNames.size(), nullptr);
+    chain.SetBranchStatus("*", 0);
+    for (unsigned int iBranch=0; iBranch<branchNames.size(); iBranch++) {
+        if (!chain.GetBranch(branchNames[iBranch].c_str())) {
+            fMsg.Print("Branch " + branchNames[iBranch] + " is not in the ntag tree of " + inFilePath + "!", pERROR);
+            return -1;
+        }
+        chain.SetBranchStatus(branchNames[iBranch].c_str(), 1);
+        chain.SetBranchAddress(branchNames[iBranch].c_str(), &branches[iBranch]);
+    }
+    unsigned int iLabel = std::find(branchNames.begin(), branchNames.end(), "Label") - branchNames.begin();
+    unsigned int iSignalRatio = std::find(branchNames.begin(), branchNames.end(), "SignalRatio") - branchNames.begin();
+
+    // columns: features, Label, Class, Weight
+    unsigned int nFeatures = features.size();
+    std::vector<std::vector<float>> columns(nFeatures + 3);
+
+    long nEntries = chain.GetEntries();
+    for (long iEntry=0; iEntry<nEntries; iEntry++) {
+        chain.GetEntry(iEntry);
+        if (iEntry % 1000 == 0)
+            fMsg.Print(Form("Exporting entry %ld / %ld...\r", iEntry, nEntries), pDEFAULT, false);
+
+        for (unsigned int iCandidate=0; iCandidate<branches[iLabel]->size(); iCandidate++) {
+            int trueLabel = branches[iLabel]->at(iCandidate);
+            float ratio = branches[iSignalRatio]->at(iCandidate);
+            bool isSignal = (trueLabel == lnH || trueLabel == lnGd) && ratio > 0.2;
+            bool isBackground = trueLabel == lNoise && ratio == 0;
+            if (!isSignal && !isBackground) continue;
+
+            for (unsigned int iFeature=0; iFeature<nFeatures; iFeature++)
+                columns[iFeature].push_back(branches[iFeature]->at(iCandidate));
+            columns[nFeatures].push_back(trueLabel);
+            columns[nFeatures+1].push_back(isSignal);
+            columns[nFeatures+2].push_back(1);
+        }
+    }
+
+    std::vector<std::string> columnNames = features;
+    columnNames.insert(columnNames.end(), {"Label", "Class", "Weight"});
+
+    std::ofstream outFile(outFilePath, std::ios::binary);
+    if (!outFile) {
+        fMsg.Print("Could not open " + outFilePath + " to write the dataset!", pWARNING);
+        return -1;
+    }
+
+    uint64_t nRows = columns[0].size();
+    uint32_t nColumns = columns.size();
+    outFile.write(DATASETMAGIC, sizeof(DATASETMAGIC));
+    outFile.write((const char*)&nRows, sizeof(nRows));
+    outFile.write((const char*)&nColumns, sizeof(nColumns));
+    for (auto const& name: columnNames) {
+        uint32_t nameLength = name.size();
+        outFile.write((const char*)&nameLength, sizeof(nameLength));
+        outFile.write(name.data(), nameLength);
+    }
+    std::vector<char> padding((HEADERALIGNMENT - outFile.tellp() % HEADERALIGNMENT) % HEADERALIGNMENT, 0);
+    outFile.write(padding.data(), padding.size());
+    for (auto const& column: columns)
+        outFile.write((const char*)column.data(), column.size()*sizeof(float));
+
+    long nSignal = std::count(columns[nFeatures+1].begin(), columns[nFeatures+1].end(), 1.f);
+    fMsg.Print(Form("Exported %ld signal and %ld background candidates to %s",
+                    nSignal, (long)nRows-nSignal, outFilePath.c_str()));
+
+    return nRows;
+}
+
+bool TrainingDataset::Open(std::string filePath)
+{
+    Close();
+
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat fileStat;
+    fstat(fd, &fileStat);
+    fMappedSize = fileStat.st_size;
+    if (fMappedSize >= sizeof(DATASETMAGIC))
+        fMappedData = mmap(nullptr, fMappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (fMappedData == MAP_FAILED || fMappedData == nullptr) {
+        fMappedData = nullptr;
+        return false;
+    }
+
+    const char* data = (const char*)fMappedData;
+    const char* end = data + fMappedSize;
+    auto read = [&](void* value, size_t size) {
+        if (data + size > end) return false;
+        std::memcpy(value, data, size); data += size;
+        return true;
+    };
+
+    char magic[sizeof(DATASETMAGIC)];
+    uint64_t nRows = 0;
+    uint32_t nColumns = 0;
+    // not a dataset, e.g., a ROOT file
+    if (!read(magic, sizeof(magic)) || std::memcmp(magic, DATASETMAGIC, sizeof(magic))) {
+        Close();
+        return false;
+    }
+    bool isValid = read(&nRows, sizeof(nRows)) && read(&nColumns, sizeof(nColumns));
+
+    for (uint32_t iColumn=0; isValid && iColumn<nColumns; iColumn++) {
+        uint32_t nameLength = 0;
+        isValid = read(&nameLength, sizeof(nameLength)) && data + nameLength <= end;
+        if (isValid) {
+            fColumnNames.push_back(std::string(data, nameLength));
+            data += nameLength;
+        }
+    }
+
+    size_t headerSize = data - (const char*)fMappedData;
+    headerSize += (HEADERALIGNMENT - headerSize % HEADERALIGNMENT) % HEADERALIGNMENT;
+    isValid = isValid && headerSize + nColumns*nRows*sizeof(float) <= fMappedSize;
+
+    if (!isValid) {
+        fMsg.Print(filePath + " is not a valid training dataset!", pWARNING);
+        Close();
+        return false;
+    }
+
+    fNRows = nRows;
+    const float* firstColumn = (const float*)((const char*)fMappedData + headerSize);
+    for (uint32_t iColumn=0; iColumn<nColumns; iColumn++)
+        fColumns.push_back(firstColumn + iColumn*nRows);
+
+    return true;
+}
+
+void TrainingDataset::Close()
+{
+    if (fMappedData) munmap(fMappedData, fMappedSize);
+    fMappedData = nullptr;
+    fMappedSize = 0;
+    fNRows = 0;
+    fColumnNames.clear();
+    fColumns.clear();
+}
+
+std::vector<std::string> TrainingDataset::GetFeatureNames() const
+{
+    std::vector<std::string> features;
+    for (auto const& name: fColumnNames)
+        if (name != "Label" && name != "Class" && name != "Weight")
+            features.push_back(name);
+    return features;
+}
+
+const float* TrainingDataset::GetColumn(std::string name) const
+{
+    auto iter = std::find(fColumnNames.begin(), fColumnNames.end(), name);
+    return iter == fColumnNames.end() ? nullptr : fColumns[iter - fColumnNames.begin()];
+}
+
+void TrainingDataset::Split(const std::vector<std::string>& features, float testFraction, unsigned int seed,
+                            DatasetSplit& train, DatasetSplit& test, int nThreads)
+{
+    std::vector<const float*> featureColumns;
+    for (auto const& feature: features) {
+        featureColumns.push_back(GetColumn(feature));
+        if (!featureColumns.back()) {
+            fMsg.Print("Feature " + feature + " is not in the dataset!", pERROR);
+            train.nRows = test.nRows = 0;
+            return;
+        }
+    }
+    const float* labelColumn = GetColumn("Label");
+    const float* classColumn = GetColumn("Class");
+    const float* weightColumn = GetColumn("Weight");
+
+    std::vector<long> rows(fNRows);
+    std::iota(rows.begin(), rows.end(), 0);
+    std::shuffle(rows.begin(), rows.end(), std::mt19937(seed));
+
+    long nTest = fNRows * testFraction;
+    unsigned int nFeatures = features.size();
+    for (auto split: {&train, &test}) {
+        split->nRows = split == &test ? nTest : fNRows - nTest;
+        split->features.resize(split->nRows * nFeatures);
+        split->labels.resize(split->nRows);
+        split->classes.resize(split->nRows);
+        split->weights.resize(split->nRows);
+    }
+
+    // copy shuffled rows [first, last) to the splits
+    auto copyRows = [&](long first, long last) {
+        for (long iRow=first; iRow<last; iRow++) {
+            DatasetSplit& split = iRow < train.nRows ? train : test;
+            long iSplitRow = iRow < train.nRows ? iRow : iRow - train.nRows;
+            long row = rows[iRow];
+            for (unsigned int iFeature=0; iFeature<nFeatures; iFeature++)
+                split.features[iSplitRow*nFeatures + iFeature] = featureColumns[iFeature][row];
+            split.labels[iSplitRow] = labelColumn ? labelColumn[row] : lUndefined;
+            split.classes[iSplitRow] = classColumn ? classColumn[row] : 0;
+            split.weights[iSplitRow] = weightColumn ? weightColumn[row] : 1;
+        }
+    };
+
+    nThreads = std::max(1, nThreads);
+    long nRowsPerThread = (fNRows + nThreads - 1) / nThreads;
+    std::vector<std::thread> threads;
+    for (int iThread=1; iThread<nThreads; iThread++)
+        threads.emplace_back(copyRows, std::min(fNRows, iThread*nRowsPerThread),
+                                       std::min(fNRows, (iThread+1)*nRowsPerThread));
+    copyRows(0, std::min(fNRows, nRowsPerThread));
+    for (auto& thread: threads) thread.join();
+}
@@ -0,0 +1,118 @@
+/*******************************************
+*
+* @file TrainingDataset.hh
+*
+* @brief Defines TrainingDataset.
+*
+********************************************/
+
+#ifndef TRAININGDATASET_HH
+#define TRAININGDATASET_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Printer.hh"
+
+/**
+ * @brief Rows of a TrainingDataset in row-major order.
+ * @see TrainingDataset::Split
+ */
+typedef struct DatasetSplit {
+    long nRows;
+    std::vector<float> features; ///< \c nRows &times; (number of features)
+    std::vector<int>   labels;   ///< TrueLabel
+    std::vector<int>   classes;  ///< 1 for signal, 0 for background
+    std::vector<float> weights;
+} DatasetSplit;
+
+/*******************************************
+*
+* @brief Compact, column-wise dataset of
+* candidate features for NN training.
+*
+* @details TrainingDataset::Export reads only
+* the given feature branches and the true
+* labels from the \c ntag trees of NTag output
+* files, and writes the training candidates
+* (signal: H/Gd captures with SignalRatio > 0.2,
+* background: noise with SignalRatio = 0,
+* as in NTagTMVAManager::TrainWeights)
+* to a binary file:
+*
+* | Content                                   | Type                  |
+* |-------------------------------------------|-----------------------|
+* | magic `NTAGDS1` and a null character      | 8 bytes               |
+* | number of rows N                          | uint64                |
+* | number of columns C                       | uint32                |
+* | C column names (length, characters)       | uint32, char[length]  |
+* | zero padding to a multiple of 64 bytes    |                       |
+* | C columns of N values each                | float32[C][N]         |
+*
+* The columns are the features, followed by
+* \c Label (true label), \c Class (1 for signal,
+* 0 for background), and \c Weight.
+* Since each column is contiguous, the file can
+* be memory-mapped as is, e.g., by numpy's
+* \c memmap for Keras training.
+*
+* TrainingDataset::Open maps the file, and
+* TrainingDataset::Split shuffles the rows and
+* splits them into training and test sets
+* on multiple threads.
+*
+********************************************/
+
+class TrainingDataset
+{
+    public:
+        TrainingDataset(Verbosity verbose=pDEFAULT);
+        ~TrainingDataset();
+
+        /**
+         * @brief Writes the training candidates of the \c ntag trees in \c inFilePath
+         * (may include wildcards) to the dataset file \c outFilePath.
+         * @return Number of exported candidates, or -1 if a branch is missing in the input
+         * or the output file could not be written.
+         */
+        long Export(std::string inFilePath, std::string outFilePath, const std::vector<std::string>& features);
+
+        /**
+         * @brief Memory-maps the dataset file \c filePath.
+         * @return \c true if the file is a valid dataset.
+         */
+        bool Open(std::string filePath);
+        void Close();
+
+        long GetNRows() const { return fNRows; }
+        const std::vector<std::string>& GetColumnNames() const { return fColumnNames; }
+        /**
+         * @brief Returns the feature column names, i.e., all but \c Label, \c Class, and \c Weight.
+         */
+        std::vector<std::string> GetFeatureNames() const;
+        /**
+         * @return Pointer to the \c GetNRows() values of the column \c name, or \c nullptr if not found.
+         */
+        const float* GetColumn(std::string name) const;
+
+        /**
+         * @brief Shuffles the rows with \c seed and puts the fraction \c testFraction of them
+         * into \c test and the rest into \c train, with the features in \c features.
+         * @details Rows are copied to the row-major splits by \c nThreads threads.
+         * If a feature is not in the dataset, both splits are left empty.
+         */
+        void Split(const std::vector<std::string>& features, float testFraction, unsigned int seed,
+                   DatasetSplit& train, DatasetSplit& test, int nThreads=1);
+
+    private:
+        void* fMappedData;
+        size_t fMappedSize;
+        long fNRows;
+        std::vector<std::string> fColumnNames;
+        std::vector<const float*> fColumns;
+
+        Printer fMsg;
+};
+
+#endif
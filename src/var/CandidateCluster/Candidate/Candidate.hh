@@ -50,6 +50,7 @@ class Candidate
         /**
          * @brief Constructor of class Candidate.
          * @param iHit A hit ID that can help identify the location of the candidate among hits.
+         * @see PMTHit::GetHitID and PMTHitCluster::GetIndex
          */
         Candidate(unsigned int iHit=0): fHitID(iHit) {}
 
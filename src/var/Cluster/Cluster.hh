@@ -66,6 +66,13 @@ class Cluster
          */
         virtual void Clear() { fElement.clear(); }
 
+        /**
+         * @brief Reserves memory for a given number of elements.
+         * @param n The number of elements to reserve memory for.
+         * @note Same as \c std::vector::reserve
+         */
+        virtual void Reserve(unsigned int n) { fElement.reserve(n); }
+
         /**
          * @brief Returns true if the Cluster object has no element.
          * @return \c true if the Cluster::fElement is empty, else \c false
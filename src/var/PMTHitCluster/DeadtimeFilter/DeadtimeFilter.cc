@@ -0,0 +1,64 @@
+#include <limits>
+
+#include "DeadtimeFilter.hh"
+
+DeadtimeFilter::DeadtimeFilter(Float deadtime)
+: fDeadtime(deadtime), fEpoch(1),
+  fLastHitTime(20000+MAXPMA+1), fLastHitIsSignal(20000+MAXPMA+1), fLastHitEpoch(20000+MAXPMA+1, 0),
+  fNHits(0), fNRemoved(0), fNRemovedBySignal(0) {}
+
+void DeadtimeFilter::Reset()
+{
+    fEpoch++;
+
+    // epoch counter wrapped around: clear the tables
+    if (!fEpoch) {
+        std::fill(fLastHitEpoch.begin(), fLastHitEpoch.end(), 0);
+        fEpoch = 1;
+    }
+
+    fNHits = 0; fNRemoved = 0; fNRemovedBySignal = 0;
+}
+
+bool DeadtimeFilter::Accept(PMTHit& hit, bool doRemove)
+{
+    unsigned int hitPMTID = hit.i();
+    if (hitPMTID >= fLastHitEpoch.size())
+        return false;
+
+    bool hasPreviousHit = (fLastHitEpoch[hitPMTID] == fEpoch);
+
+    Float tDiff = hasPreviousHit ? hit.t() - fLastHitTime[hitPMTID] : std::numeric_limits<Float>::max();
+    hit.SetTDiff(tDiff);
+    fNHits++;
+
+    if (!doRemove || tDiff > fDeadtime) {
+        fLastHitTime[hitPMTID]     = hit.t();
+        fLastHitIsSignal[hitPMTID] = hit.s();
+        fLastHitEpoch[hitPMTID]    = fEpoch;
+        return true;
+    }
+
+    fNRemoved++;
+    if (hit.s() || fLastHitIsSignal[hitPMTID])
+        fNRemovedBySignal++;
+
+    return false;
+}
+
+HitReductionResult DeadtimeFilter::GetResult() const
+{
+    HitReductionResult res;
+    res.title            = Form("%3.0f ns deadtime", fDeadtime);
+    res.tMin             = std::numeric_limits<Float>::infinity();
+    res.tMax             = std::numeric_limits<Float>::infinity();
+    res.nBeforeWhole     = fNHits;
+    res.nBeforeRange     = fNHits;
+    res.nAfterRange      = fNHits - fNRemoved;
+    res.nAfterWhole      = res.nAfterRange;
+    res.nRemoved         = fNRemoved;
+    res.nMatch           = fNRemoved;
+    res.nRemovedBySignal = fNRemovedBySignal;
+    res.nRemovedByNoise  = fNRemoved - fNRemovedBySignal;
+    return res;
+}
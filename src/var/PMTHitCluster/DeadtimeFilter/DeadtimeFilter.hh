@@ -0,0 +1,61 @@
+/**
+ * @file DeadtimeFilter.hh
+ */
+
+#ifndef DEADTIMEFILTER_HH
+#define DEADTIMEFILTER_HH
+
+#include <cstdint>
+#include <vector>
+
+#include "PMTHitCluster.hh"
+
+/**
+ * @brief Applies PMT deadtime to a time-ordered stream of hits.
+ *
+ * @details Hits are passed one by one in time order with DeadtimeFilter::Accept,
+ * which allows the deadtime to be applied while merging hit streams
+ * instead of on a whole PMTHitCluster afterwards.
+ * The last accepted hit time per PMT is stamped with an epoch number,
+ * so DeadtimeFilter::Reset does not need to clear the per-PMT tables.
+ *
+ * @see PMTHitCluster::ApplyDeadtime
+ */
+class DeadtimeFilter
+{
+    public:
+        DeadtimeFilter(Float deadtime=0);
+
+        /**
+         * @brief Starts a new hit stream.
+         */
+        void Reset();
+        void SetDeadtime(Float deadtime) { fDeadtime = deadtime; }
+
+        /**
+         * @brief Checks if \c hit is outside the deadtime of the last accepted hit of the same PMT.
+         * @details Sets the time difference to the last accepted hit (PMTHit::dt) of \c hit.
+         * @param hit A hit that is not earlier than all hits passed since the last DeadtimeFilter::Reset.
+         * @param doRemove If \c false, all hits are accepted and only the time differences are set.
+         * @return \c true if \c hit should be kept. Hits with PMT IDs outside the per-PMT tables
+         * are rejected without being counted.
+         */
+        bool Accept(PMTHit& hit, bool doRemove=true);
+
+        /**
+         * @brief Returns the hit reduction summary since the last DeadtimeFilter::Reset.
+         */
+        HitReductionResult GetResult() const;
+
+    private:
+        Float fDeadtime;
+        uint32_t fEpoch;
+
+        std::vector<Float>    fLastHitTime;
+        std::vector<bool>     fLastHitIsSignal;
+        std::vector<uint32_t> fLastHitEpoch;
+
+        unsigned int fNHits, fNRemoved, fNRemovedBySignal;
+};
+
+#endif
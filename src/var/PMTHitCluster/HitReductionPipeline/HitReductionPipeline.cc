@@ -0,0 +1,104 @@
+#include "DeadtimeFilter.hh"
+#include "HitReductionPipeline.hh"
+
+HitReductionPipeline::HitReductionPipeline()
+: fVertex(), fHasVertex(false),
+  fQSumTMin(std::numeric_limits<Float>::infinity()), fQSumTMax(-std::numeric_limits<Float>::infinity()), fQSum(0) {}
+
+void HitReductionPipeline::Clear()
+{
+    fSteps.clear();
+}
+
+void HitReductionPipeline::AddCut(std::string title, std::function<bool(const PMTHit&)> cut,
+                                  Float tMin, Float tMax, bool useToF)
+{
+    Step step;
+    step.cut            = cut;
+    step.deadtimeFilter = nullptr;
+    step.deadtime       = 0;
+    step.tBurstWidth    = 0;
+    step.useToF         = useToF;
+    step.result.title   = title;
+    step.result.tMin    = tMin;
+    step.result.tMax    = tMax;
+    fSteps.push_back(step);
+}
+
+void HitReductionPipeline::AddDeadtime(DeadtimeFilter* filter, Float deadtime, float tBurstWidth)
+{
+    Step step;
+    step.deadtimeFilter = filter;
+    step.deadtime       = deadtime;
+    step.tBurstWidth    = tBurstWidth;
+    step.useToF         = false;
+    fSteps.push_back(step);
+}
+
+std::vector<HitReductionResult> HitReductionPipeline::Apply(PMTHitCluster& hits)
+{
+    hits.RemoveVertex();
+    hits.Sort();
+
+    for (auto& step: fSteps) {
+        if (step.deadtimeFilter) {
+            step.deadtimeFilter->SetDeadtime(step.deadtime);
+            step.deadtimeFilter->Reset();
+        }
+        else {
+            auto& res = step.result;
+            res.nBeforeWhole = 0; res.nBeforeRange = 0; res.nMatch = 0;
+            res.nRemoved = 0; res.nAfterWhole = 0; res.nAfterRange = 0;
+            res.nRemovedBySignal = 0; res.nRemovedByNoise = 0;
+        }
+    }
+    fQSum = 0;
+
+    hits.FilterHits([&](PMTHit& hit) {
+        for (auto& step: fSteps)
+            if (!Pass(step, hit)) return false;
+
+        // hits have no vertex, so t() is the raw hit time
+        if (fQSumTMin < hit.t() && hit.t() < fQSumTMax)
+            fQSum += hit.q();
+        return true;
+    });
+
+    std::vector<HitReductionResult> results;
+    for (auto const& step: fSteps)
+        results.push_back(step.deadtimeFilter ? step.deadtimeFilter->GetResult() : step.result);
+
+    return results;
+}
+
+bool HitReductionPipeline::Pass(Step& step, PMTHit& hit)
+{
+    if (step.deadtimeFilter) {
+        if (!step.deadtimeFilter->Accept(hit)) return false;
+        hit.SetBurstFlag(hit.dt() < step.tBurstWidth);
+        return true;
+    }
+
+    auto& res = step.result;
+    bool isInRange = true;
+    if (res.tMin > -std::numeric_limits<Float>::infinity() || res.tMax < std::numeric_limits<Float>::infinity()) {
+        Float t = hit.t();
+        if (step.useToF && fHasVertex)
+            t -= (hit.GetPosition() - fVertex).Mag() / NTagConstant::C_WATER;
+        isInRange = (res.tMin < t) && (t < res.tMax);
+    }
+    bool isMatch = step.cut(hit);
+
+    res.nBeforeWhole++;
+    if (isInRange) res.nBeforeRange++;
+    if (isMatch) res.nMatch++;
+
+    if (isInRange && isMatch) {
+        res.nRemoved++;
+        return false;
+    }
+
+    res.nAfterWhole++;
+    if (isInRange) res.nAfterRange++;
+    return true;
+}
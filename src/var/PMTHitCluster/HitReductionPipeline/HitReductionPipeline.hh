@@ -0,0 +1,91 @@
+/**
+ * @file HitReductionPipeline.hh
+ */
+
+#ifndef HITREDUCTIONPIPELINE_HH
+#define HITREDUCTIONPIPELINE_HH
+
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "PMTHitCluster.hh"
+
+class DeadtimeFilter;
+
+/**
+ * @brief Applies a sequence of hit reduction steps to a PMTHitCluster in a single pass.
+ *
+ * @details Steps are added in the order they should be applied, and
+ * HitReductionPipeline::Apply streams the time-ordered hits through all steps at once.
+ * Each step sees only the hits kept by the previous steps,
+ * so the HitReductionResult of each step is the same as
+ * calling PMTHitCluster::RemoveHits or PMTHitCluster::ApplyDeadtime one by one.
+ * The sum of hit charges of the kept hits in a raw hit time range
+ * can be accumulated in the same pass (e.g., QISMSK).
+ *
+ * @see PMTHitCluster::FilterHits
+ */
+class HitReductionPipeline
+{
+    public:
+        HitReductionPipeline();
+
+        /**
+         * @brief Removes all steps.
+         */
+        void Clear();
+
+        /**
+         * @brief Adds a step that removes hits for which \c cut returns \c true within the time range (\c tMin, \c tMax).
+         * @param useToF If \c true, the time range is checked with the ToF-subtracted hit time
+         * from the vertex set by HitReductionPipeline::SetVertex.
+         */
+        void AddCut(std::string title, std::function<bool(const PMTHit&)> cut,
+                    Float tMin=-std::numeric_limits<Float>::infinity(),
+                    Float tMax=std::numeric_limits<Float>::infinity(), bool useToF=false);
+        /**
+         * @brief Adds a PMT deadtime step, which also sets the burst flags of the kept hits.
+         * @see PMTHitCluster::SetBurstFlag
+         */
+        void AddDeadtime(DeadtimeFilter* filter, Float deadtime, float tBurstWidth=30000);
+
+        void SetVertex(const TVector3& vertex) { fVertex = vertex; fHasVertex = true; }
+        void RemoveVertex() { fHasVertex = false; }
+
+        /**
+         * @brief Sums the charges of the kept hits within the raw hit time range (\c tMin, \c tMax).
+         * @see HitReductionPipeline::GetQSum
+         */
+        void SetQSumRange(Float tMin, Float tMax) { fQSumTMin = tMin; fQSumTMax = tMax; }
+        float GetQSum() const { return fQSum; }
+
+        /**
+         * @brief Applies all steps to \c hits in a single pass.
+         * @details The vertex of \c hits is removed, and \c hits are left in raw time order.
+         * @return The HitReductionResult of each step, in the order of the steps.
+         */
+        std::vector<HitReductionResult> Apply(PMTHitCluster& hits);
+
+    private:
+        typedef struct Step {
+            std::function<bool(const PMTHit&)> cut;
+            DeadtimeFilter* deadtimeFilter;
+            Float deadtime;
+            float tBurstWidth;
+            bool useToF;
+            HitReductionResult result;
+        } Step;
+
+        bool Pass(Step& step, PMTHit& hit);
+
+        std::vector<Step> fSteps;
+
+        TVector3 fVertex;
+        bool fHasVertex;
+
+        Float fQSumTMin, fQSumTMax;
+        float fQSum;
+};
+
+#endif
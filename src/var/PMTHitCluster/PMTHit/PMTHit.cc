@@ -6,7 +6,7 @@
 #include "PMTHitCluster.hh"
 
 PMTHit::PMTHit(Float t, float q, int i, int f, bool s)
-: fT(t), fToF(0), fTDiff(0), fQ(q), fPMTID(i), fFlag(f), fIsSignal(s), fIsBurst(false), fIsTagged(false)
+: fT(t), fToF(0), fTDiff(0), fQ(q), fPMTID(i), fRawIndex(0), fHitID(0), fFlag(f), fIsSignal(s), fIsBurst(false), fIsTagged(false)
 {
     if (1 <= fPMTID && fPMTID <= MAXPM) {
         fPMTPosition = TVector3(NTagConstant::PMTXYZ[fPMTID-1]);
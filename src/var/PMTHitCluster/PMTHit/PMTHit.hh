@@ -1,6 +1,7 @@
 #ifndef PMTHIT_HH
 #define PMTHIT_HH
 
+#include <cstdint>
 #include <iostream>
 #include <functional>
 
@@ -30,7 +31,7 @@ class PMTHit
     public:
         PMTHit(Float t, float q, int i, int f, bool s=false);
 
-        inline const Float& t() const { return fT; }
+        inline Float t() const { return fT - fToF; }
         inline const Float& dt() const { return fTDiff; }
         inline const float& q() const { return fQ; }
         inline const unsigned int& i() const { return fPMTID; }
@@ -39,7 +40,7 @@ class PMTHit
         inline const bool& b() const { return fIsBurst; }
         inline const bool& n() const { return fIsTagged; }
 
-        inline void SetT(Float f)  { fT = f; }
+        inline void SetT(Float f)  { fT = f + fToF; }
         inline void SetTDiff(Float f)  { fTDiff = f; }
         inline void SetQ(float f)  { fQ = f; }
         inline void SetID(int i)   { fPMTID = i; }
@@ -50,31 +51,42 @@ class PMTHit
         inline void SetBurstFlag(bool b) { fIsBurst=b; }
         inline void SetTagFlag(bool b) { fIsTagged=b; }
         //inline void Dump() const { std::cout << "T: " << fT << " Q: " << fQ << " I: " << fPMTID << " F: " << fFlag << " ToF: " << fToF << "\n"; }
-        inline void Dump() const { std::cout << "T: " << fT << " Q: " << fQ << " I: " << fPMTID << " ToF: " << fToF
+        inline void Dump() const { std::cout << "T: " << t() << " Q: " << fQ << " I: " << fPMTID << " ToF: " << fToF
                                              << " S: " << fIsSignal << " B: " << fIsBurst << " Tag: " << fIsTagged
                                              << " dT: " << (fTDiff>1e308 ? std::string("") : std::to_string(fTDiff)) << "\n"; }
 
+        // raw hit time is kept as is, and t() returns the ToF-subtracted time
         void SetToFAndDirection(const TVector3& vertex)
         {
-            fT += fToF;
             TVector3 displacement = fPMTPosition - vertex;
             fHitDirection = displacement.Unit();
             fToF = displacement.Mag() / NTagConstant::C_WATER;
-            fT -= fToF;
+        }
+
+        inline void SetToFAndDirection(const Float& tof, const TVector3& direction)
+        {
+            fToF = tof;
+            fHitDirection = direction;
         }
 
         inline void UnsetToFAndDirection()
         {
-            fT += fToF;
             fToF = 0;
             fHitDirection = TVector3();
         }
 
+        inline const uint32_t& GetHitID() const { return fHitID; }
+        inline void SetHitID(uint32_t id) { fHitID = id; }
+
+        inline const Float& GetRawTime() const { return fT; }
+        inline const unsigned int& GetRawIndex() const { return fRawIndex; }
+        inline void SetRawIndex(unsigned int i) { fRawIndex = i; }
+
         inline const Float& GetToF() const { return fToF; }
         inline const TVector3& GetDirection() const { return fHitDirection; }
         inline const TVector3& GetPosition() const { return fPMTPosition; }
 
-        inline bool operator<(const PMTHit &hit) const { return fT < hit.t(); }
+        inline bool operator<(const PMTHit &hit) const { return t() < hit.t(); }
 
         //void FindMinAngle(PMTHitCluster* cluster);
         //void FindDirAngle(TVector3 vec);
@@ -90,12 +102,13 @@ class PMTHit
         bool operator!=(const PMTHit& hit) const;
 
     private:
-        PMTHit(): fT(0), fToF(0), fTDiff(0), fQ(0), fPMTID(0), fFlag(2), fIsSignal(false), fIsBurst(false), fIsTagged(false) {}
+        PMTHit(): fT(0), fToF(0), fTDiff(0), fQ(0), fPMTID(0), fRawIndex(0), fHitID(0), fFlag(2), fIsSignal(false), fIsBurst(false), fIsTagged(false) {}
 
     protected:
         Float fT, fToF, fTDiff;
         float fQ;
-        unsigned int fPMTID;
+        unsigned int fPMTID, fRawIndex;
+        uint32_t fHitID;
         int fFlag;
         bool fIsSignal, fIsBurst, fIsTagged;
         TVector3 fPMTPosition;
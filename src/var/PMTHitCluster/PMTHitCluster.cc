@@ -4,6 +4,7 @@
 #include <cmath>
 #include <limits>
 #include <iomanip>
+#include <memory>
 
 #include <TTree.h>
 #include <TMath.h>
@@ -17,39 +18,24 @@
 
 #include "Calculator.hh"
 #include "PMTHitCluster.hh"
+#include "DeadtimeFilter.hh"
 
 PMTHitCluster::PMTHitCluster()
-:fIsSorted(false), fHasVertex(false) {}
+:fIsSorted(true), fHasVertex(false), fIsRawIndexed(false), fIsOrderIndexed(false), fIsIDIndexed(false), fNextHitID(0) {}
 
-PMTHitCluster::PMTHitCluster(sktqz_common sktqz)
+PMTHitCluster::PMTHitCluster(const sktqz_common& sktqz)
 :PMTHitCluster()
 {
-    for (int iHit=0; iHit<sktqz.nqiskz; iHit++) {
-        PMTHit hit{ /*T*/ sktqz.tiskz[iHit],
-                    /*Q*/ sktqz.qiskz[iHit],
-                    /*I*/ sktqz.icabiz[iHit],
-                    /*F*/ sktqz.ihtiflz[iHit],
-                    /*S*/ sktqz.ihtiflz[iHit]&(1<<12)
-                  };
-        Append(hit);
-    }
+    AddSKTQZ(sktqz);
 }
 
-PMTHitCluster::PMTHitCluster(sktqaz_common sktqaz)
+PMTHitCluster::PMTHitCluster(const sktqaz_common& sktqaz)
 :PMTHitCluster()
 {
-    for (int iHit=0; iHit<sktqaz.nhitaz; iHit++) {
-        PMTHit hit{ /*T*/ sktqaz.taskz[iHit],
-                    /*Q*/ sktqaz.qaskz[iHit],
-                    /*I*/ sktqaz.icabaz[iHit],
-                    /*F*/ sktqaz.ihtflz[iHit],
-                    /*S*/ sktqaz.ihtflz[iHit]&(1<<12)
-                  };
-        Append(hit);
-    }
+    AddSKTQAZ(sktqaz);
 }
 
-PMTHitCluster::PMTHitCluster(TQReal* tqreal, int flag)
+PMTHitCluster::PMTHitCluster(const TQReal* tqreal, int flag)
 :PMTHitCluster()
 {
     AddTQReal(tqreal, flag);
@@ -60,8 +46,14 @@ void PMTHitCluster::Append(const PMTHit& hit)
     int i = hit.i();
 
     // append only hits with meaningful PMT ID
-    if ((1 <= i && i <= MAXPM) || (20001 <= i && i <= 20000+MAXPMA))
-            fElement.push_back(hit);
+    if ((1 <= i && i <= MAXPM) || (20001 <= i && i <= 20000+MAXPMA)) {
+        // appending in time order keeps the cluster sorted
+        if (!fElement.empty() && hit.t() < fElement.back().t())
+            fIsSorted = false;
+        fElement.push_back(hit);
+        fElement.back().SetHitID(fNextHitID++);
+        InvalidateVertexCache();
+    }
     //else
     //    std::cerr << "[PMTHitCluster] " << hit.i() << " at t=" << hit.t() << " ns is not a valid PMT cable ID!\n";
 }
@@ -115,20 +107,56 @@ void PMTHitCluster::Clear()
 {
     //*this = PMTHitCluster();
     fElement.clear();
-    fIsSorted = false;
+    fIsSorted = true;
     fHasVertex = false;
+    fNextHitID = 0;
+    InvalidateVertexCache();
     fVertex = TVector3();
     fMeanDirection = TVector3();
     ClearBranches();
 }
 
-void PMTHitCluster::AddTQReal(TQReal* tqreal, int flag)
+void PMTHitCluster::AddSKTQZ(const sktqz_common& sktqz, Float tOffset, bool inGateOnly)
+{
+    fElement.reserve(fElement.size() + sktqz.nqiskz);
+
+    for (int iHit=0; iHit<sktqz.nqiskz; iHit++) {
+        int flag = sktqz.ihtiflz[iHit];
+        if (inGateOnly && !(flag & (1<<1))) continue;
+
+        Append({ /*T*/ sktqz.tiskz[iHit] + tOffset,
+                 /*Q*/ sktqz.qiskz[iHit],
+                 /*I*/ sktqz.icabiz[iHit],
+                 /*F*/ flag,
+                 /*S*/ (flag&(1<<12)) != 0 });
+    }
+}
+
+void PMTHitCluster::AddSKTQAZ(const sktqaz_common& sktqaz, Float tOffset, bool inGateOnly)
 {
-    auto& t = tqreal->T;
-    auto& q = tqreal->Q;
-    auto& i = tqreal->cables;
+    fElement.reserve(fElement.size() + sktqaz.nhitaz);
 
-    for (unsigned int j=0; j<=t.size(); j++) {
+    for (int iHit=0; iHit<sktqaz.nhitaz; iHit++) {
+        int flag = sktqaz.ihtflz[iHit];
+        if (inGateOnly && !(flag & (1<<1))) continue;
+
+        Append({ /*T*/ sktqaz.taskz[iHit] + tOffset,
+                 /*Q*/ sktqaz.qaskz[iHit],
+                 /*I*/ sktqaz.icabaz[iHit],
+                 /*F*/ flag,
+                 /*S*/ (flag&(1<<12)) != 0 });
+    }
+}
+
+void PMTHitCluster::AddTQReal(const TQReal* tqreal, int flag)
+{
+    auto const& t = tqreal->T;
+    auto const& q = tqreal->Q;
+    auto const& i = tqreal->cables;
+
+    fElement.reserve(fElement.size() + t.size());
+
+    for (unsigned int j=0; j<t.size(); j++) {
         Append({t[j], q[j], i[j]&0x0000FFFF, flag});
     }
 }
@@ -136,27 +164,138 @@ void PMTHitCluster::AddTQReal(TQReal* tqreal, int flag)
 void PMTHitCluster::SetVertex(const TVector3& inVertex)
 {
     if (!fHasVertex || fVertex != inVertex) {
-        if (fHasVertex) RemoveVertex();
-
         fVertex = inVertex;
         fHasVertex = true;
 
-        SetToF();
-        Sort();
+        ApplyVertexView(GetVertexView(inVertex));
     }
 }
 
 void PMTHitCluster::RemoveVertex()
 {
     if (fHasVertex) {
-        bool unset = true;
-        SetToF(unset);
+        // hits are left in raw time order
+        if (fIsRawIndexed && !fElement.empty()) {
+            std::vector<PMTHit> rawHits(fElement.size(), fElement.front());
+            for (auto const& hit: fElement)
+                rawHits[hit.GetRawIndex()] = hit;
+            fElement.swap(rawHits);
+        }
+        else
+            IndexRawHits();
+
+        for (auto& hit: fElement)
+            hit.UnsetToFAndDirection();
 
         fVertex = TVector3();
         fHasVertex = false;
 
-        fIsSorted = false;
+        fIsSorted = true;
+        fIsOrderIndexed = true;
+    }
+}
+
+void PMTHitCluster::IndexRawHits()
+{
+    std::vector<Float> rawHitTimes;
+    rawHitTimes.reserve(fElement.size());
+    for (auto const& hit: fElement)
+        rawHitTimes.push_back(hit.GetRawTime());
+
+    std::vector<unsigned int> sortedIndex;
+    GetSortedIndex(rawHitTimes, sortedIndex);
+
+    std::vector<PMTHit> rawHits;
+    rawHits.reserve(fElement.size());
+    for (unsigned int iHit=0; iHit<sortedIndex.size(); iHit++) {
+        rawHits.push_back(fElement[sortedIndex[iHit]]);
+        rawHits.back().SetRawIndex(iHit);
+    }
+    fElement.swap(rawHits);
+
+    fVertexCache.clear();
+    fIsRawIndexed = true;
+    fIsIDIndexed = false;
+    fIsSorted = !fHasVertex;
+    fIsOrderIndexed = !fHasVertex;
+}
+
+void PMTHitCluster::BuildIDIndex()
+{
+    uint32_t maxID = 0;
+    for (auto const& hit: fElement)
+        maxID = std::max(maxID, hit.GetHitID());
+
+    fRawIndexOfID.assign(maxID+1, std::numeric_limits<unsigned int>::max());
+    for (auto const& hit: fElement)
+        fRawIndexOfID[hit.GetHitID()] = hit.GetRawIndex();
+
+    fIsIDIndexed = true;
+}
+
+const VertexView& PMTHitCluster::GetVertexView(const TVector3& vertex)
+{
+    if (!fIsRawIndexed) IndexRawHits();
+
+    for (auto it = fVertexCache.begin(); it != fVertexCache.end(); ++it) {
+        if (it->vertex == vertex) {
+            fVertexCache.splice(fVertexCache.begin(), fVertexCache, it);
+            return fVertexCache.front();
+        }
+    }
+
+    // reuse the least recently used view if the cache is full
+    if (fVertexCache.size() < NVERTEXCACHE)
+        fVertexCache.emplace_front();
+    else
+        fVertexCache.splice(fVertexCache.begin(), fVertexCache, std::prev(fVertexCache.end()));
+
+    auto& view = fVertexCache.front();
+    unsigned int nHits = fElement.size();
+    view.vertex = vertex;
+    view.tof.resize(nHits);
+    view.direction.resize(nHits);
+    view.order.resize(nHits);
+    view.position.resize(nHits);
+
+    std::vector<Float> residualT(nHits);
+    for (auto const& hit: fElement) {
+        unsigned int iRaw = hit.GetRawIndex();
+        TVector3 displacement = hit.GetPosition() - vertex;
+        view.tof[iRaw] = displacement.Mag() / NTagConstant::C_WATER;
+        view.direction[iRaw] = displacement.Unit();
+        residualT[iRaw] = hit.GetRawTime() - view.tof[iRaw];
+    }
+
+    GetSortedIndex(residualT, view.order);
+    for (unsigned int iHit=0; iHit<nHits; iHit++)
+        view.position[view.order[iHit]] = iHit;
+
+    return view;
+}
+
+void PMTHitCluster::ApplyVertexView(const VertexView& view)
+{
+    if (fElement.empty()) {
+        fIsSorted = true;
+        fIsOrderIndexed = true;
+        return;
+    }
+
+    std::vector<unsigned int> position(fElement.size());
+    for (unsigned int iHit=0; iHit<fElement.size(); iHit++)
+        position[fElement[iHit].GetRawIndex()] = iHit;
+
+    std::vector<PMTHit> orderedHits;
+    orderedHits.reserve(fElement.size());
+    for (auto const& iRaw: view.order) {
+        orderedHits.push_back(fElement[position[iRaw]]);
+        orderedHits.back().SetToFAndDirection(view.tof[iRaw], view.direction[iRaw]);
     }
+    fElement.swap(orderedHits);
+
+    fIsSorted = true;
+    fIsOrderIndexed = true;
 }
 
 HitReductionResult PMTHitCluster::RemoveHits(std::function<bool(const PMTHit&)> lambda, Float tMin, Float tMax)
@@ -173,6 +312,7 @@ HitReductionResult PMTHitCluster::RemoveHits(std::function<bool(const PMTHit&)>
     res.nRemoved     = std::count_if(fElement.begin(), fElement.end(), cut);
 
     fElement.erase(std::remove_if(fElement.begin(), fElement.end(), cut), fElement.end());
+    InvalidateVertexCache();
 
     res.nAfterWhole = GetSize();
     int nActuallyRemoved = res.nBeforeWhole - res.nAfterWhole;
@@ -189,18 +329,25 @@ HitReductionResult PMTHitCluster::RemoveBadChannels(Float tMin, Float tMax)
 
     if (fElement.empty()) return res;
 
+    res = RemoveHits(GetBadChannelCut(), tMin, tMax);
+    res.title = "Bad PMTs";
+    
+    return res;
+}
+
+std::function<bool(const PMTHit&)> PMTHitCluster::GetBadChannelCut() const
+{
     auto idCut = [](PMTHit const & hit){ return (hit.i() > MAXPM) ||
                                                 (combad_.ibad[hit.i()-1] > 0) ||
                                                 (comdark_.dark_rate[hit.i()-1] == 0); };
     auto odCut = [](PMTHit const & hit){ return (hit.i() < 20000) || (hit.i() > 20000+MAXPMA) ||
                                                 (combada_.ibada[hit.i()-20000-1] > 0) ||
                                                 (comdark_.dark_rate_od[hit.i()-20000-1] == 0); };
-    auto cut = (fElement.at(0).i()<=MAXPM) ? idCut : odCut;
 
-    res = RemoveHits(cut, tMin, tMax);
-    res.title = "Bad PMTs";
-    
-    return res;
+    if (!fElement.empty() && fElement.at(0).i() > MAXPM)
+        return odCut;
+    else
+        return idCut;
 }
 
 HitReductionResult PMTHitCluster::RemoveNegativeHits(Float tMin, Float tMax)
@@ -217,6 +364,18 @@ HitReductionResult PMTHitCluster::RemoveLargeQHits(float qThreshold, Float tMin,
     return res;
 }
 
+void PMTHitCluster::FilterHits(std::function<bool(PMTHit&)> keep)
+{
+    // compact the kept hits in place, keeping their order
+    auto lastKeptHit = fElement.begin();
+    for (auto& hit: fElement) {
+        if (keep(hit))
+            *lastKeptHit++ = hit;
+    }
+    fElement.erase(lastKeptHit, fElement.end());
+    InvalidateVertexCache();
+}
+
 unsigned int PMTHitCluster::CountIf(std::function<bool(const PMTHit&)> lambda)
 {
     return std::count_if(fElement.begin(), fElement.end(), lambda);
@@ -233,25 +392,29 @@ void PMTHitCluster::FindMeanDirection()
     fMeanDirection = GetMean(dirVec).Unit();
 }
 
-void PMTHitCluster::SetToF(bool unset)
+void PMTHitCluster::Sort()
 {
-    if (!fHasVertex)
-        std::cerr << "WARNING: Vertex is not set for PMTHitCluster in " << this
-                  << ", skipping ToF-subtraction..."<< std::endl;
-    else {
-        fIsSorted = false;
-        for (auto& hit: fElement) {
-            if (unset)
-                hit.UnsetToFAndDirection();
-            else
-                hit.SetToFAndDirection(fVertex);
+    // hit times may have been modified since the last sort,
+    // so the cached vertex views are dropped as well
+    if (!fIsSorted) {
+        if (!std::is_sorted(fElement.begin(), fElement.end(),
+                            [](const PMTHit& hit1, const PMTHit& hit2) {return hit1.t() < hit2.t();})) {
+            std::vector<Float> hitTimes;
+            hitTimes.reserve(fElement.size());
+            for (auto const& hit: fElement)
+                hitTimes.push_back(hit.t());
+
+            std::vector<unsigned int> sortedIndex;
+            GetSortedIndex(hitTimes, sortedIndex);
+
+            std::vector<PMTHit> sortedHits;
+            sortedHits.reserve(fElement.size());
+            for (auto const& iHit: sortedIndex)
+                sortedHits.push_back(fElement[iHit]);
+            fElement.swap(sortedHits);
         }
+        InvalidateVertexCache();
     }
-}
-
-void PMTHitCluster::Sort()
-{
-    std::sort(fElement.begin(), fElement.end(), [](const PMTHit& hit1, const PMTHit& hit2) {return hit1.t() < hit2.t();} );
     fIsSorted = true;
 }
 
@@ -376,11 +539,16 @@ PMTHitCluster PMTHitCluster::SliceRange(Float startT, Float lowT, Float upT)
     unsigned int low = GetLowerBoundIndex(startT + lowT);
     unsigned int up  = GetUpperBoundIndex(startT + upT);
 
-    if (fHasVertex)
-        selectedHits.SetVertex(fVertex);
+    // selected hits are already ToF-subtracted and sorted,
+    // so the vertex is copied without recalculating ToF
+    selectedHits.fVertex = fVertex;
+    selectedHits.fHasVertex = fHasVertex;
 
-    for (unsigned int iHit = low; iHit <= up; iHit++)
-        selectedHits.Append(fElement.at(iHit));
+    if (low <= up)
+        selectedHits.fElement.assign(fElement.begin()+low, fElement.begin()+up+1);
+    selectedHits.fIsSorted = true;
+    // selected hits keep their IDs, so hits appended later should not reuse them
+    selectedHits.fNextHitID = fNextHitID;
 
     return selectedHits;
 }
@@ -390,14 +558,25 @@ PMTHitCluster PMTHitCluster::SliceRange(Float lowT, Float upT)
     return SliceRange(Float(0), lowT, upT);
 }
 
-unsigned int PMTHitCluster::GetIndex(PMTHit hit)
+unsigned int PMTHitCluster::GetIndex(const PMTHit& hit)
 {
+    uint32_t hitID = hit.GetHitID();
+
+    // hit ID -> raw index -> position in the current hit order
+    if (fIsRawIndexed && fIsOrderIndexed) {
+        if (!fIsIDIndexed) BuildIDIndex();
+        if (hitID < fRawIndexOfID.size() && fRawIndexOfID[hitID] < GetSize()) {
+            unsigned int iRaw = fRawIndexOfID[hitID];
+            unsigned int i = fHasVertex ? fVertexCache.front().position[iRaw] : iRaw;
+            if (fElement[i].GetHitID() == hitID)
+                return i;
+        }
+    }
+
     bool isFound = false;
     unsigned int i = 0;
     for (i=0; i<GetSize(); i++) {
-        if (fabs(hit.t() - fElement.at(i).t()) < 1 &&
-            fabs(hit.q() - fElement.at(i).q()) < 1e-5 &&
-            hit.i() == fElement.at(i).i()) {
+        if (fElement[i].GetHitID() == hitID) {
             isFound = true;
             break;
         }
@@ -416,15 +595,8 @@ void PMTHitCluster::AddTimeOffset(Float tOffset)
         hit = hit + tOffset;
 }
 
-HitReductionResult PMTHitCluster::ApplyDeadtime(Float deadtime, bool doRemove)
+HitReductionResult PMTHitCluster::ApplyDeadtime(Float deadtime, bool doRemove, DeadtimeFilter* filter)
 {
-    HitReductionResult res;
-    res.title        = Form("%3.0f ns deadtime", deadtime);
-    res.tMin         = std::numeric_limits<Float>::infinity();
-    res.tMax         = std::numeric_limits<Float>::infinity();
-    res.nBeforeWhole = GetSize();
-    res.nBeforeRange = res.nBeforeWhole;
-
     TVector3 tempVertex;
     bool bHadVertex = false;
     if (fHasVertex) {
@@ -433,53 +605,18 @@ HitReductionResult PMTHitCluster::ApplyDeadtime(Float deadtime, bool doRemove)
         bHadVertex = true;
     }
 
-    std::array<Float, 20000+MAXPMA+1> HitTime;
-    std::array<bool, 20000+MAXPMA+1> HitType;
-    HitTime.fill(std::numeric_limits<Float>::lowest());
-    HitType.fill(0);
-
-    //std::array<Float, MAXPM+1>  IDHitTime;
-    //std::array<Float, MAXPMA+1> ODHitTime;
-    //IDHitTime.fill(std::numeric_limits<Float>::lowest());
-    //ODHitTime.fill(std::numeric_limits<Float>::lowest());
-
-    std::vector<PMTHit> dtCorrectedHits;
-
-    //if (!fIsSorted) Sort();
-    Sort();
-    res.nRemovedBySignal = 0;
-    for (auto& hit: fElement) {
-        int hitPMTID = hit.i();
-        Float tDiff = hit.t() - HitTime[hitPMTID];
-        hit.SetTDiff(tDiff);
-        if (!doRemove || tDiff>deadtime) {
-            //hit.SetBurstFlag(tDiff<deadtime);
-            dtCorrectedHits.push_back(hit);
-            HitTime[hitPMTID] = hit.t();
-            HitType[hitPMTID] = hit.s();
-        }
-        else if (hit.s()) {
-            //std::cout << "Removing signal hit within deadtime " << deadtime << " ns: "; hit.Dump();
-            res.nRemovedBySignal++;
-        }
-        else if (HitType[hitPMTID]) {
-            //std::cout << "Removing noise hit due to signal within deadtime " << deadtime << " ns: "; hit.Dump();
-            res.nRemovedBySignal++;
-        }
-        //else {
-        //    HitTime[hitPMTID] = hit.t();
-        //    HitType[hitPMTID] = hit.s();
-        //    std::cout << "Removing noise hit due to noise within deadtime " << deadtime << " ns: "; hit.Dump();
-        //}
+    std::unique_ptr<DeadtimeFilter> ownFilter;
+    if (!filter) {
+        ownFilter.reset(new DeadtimeFilter);
+        filter = ownFilter.get();
     }
+    filter->SetDeadtime(deadtime);
+    filter->Reset();
 
-    res.nAfterRange     = dtCorrectedHits.size();
-    res.nAfterWhole     = res.nAfterRange;
-    res.nRemoved        = res.nBeforeRange - res.nAfterRange;
-    res.nMatch          = res.nRemoved;
-    res.nRemovedByNoise = res.nRemoved - res.nRemovedBySignal;
+    Sort();
+    FilterHits([&](PMTHit& hit){ return filter->Accept(hit, doRemove); });
 
-    fElement = dtCorrectedHits;
+    HitReductionResult res = filter->GetResult();
 
     if (bHadVertex)
         SetVertex(tempVertex);
@@ -758,6 +895,7 @@ void PMTHitCluster::ApplyCut(std::function<float(const PMTHit&)> lambda, float m
         if (min > lambda(hit) || lambda(hit) > max)
             fElement.erase(fElement.begin()+iHit);
     }
+    InvalidateVertexCache();
 }
 
 void PMTHitCluster::MakeBranches()
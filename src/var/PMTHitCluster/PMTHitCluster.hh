@@ -3,6 +3,7 @@
 
 #include <functional>
 #include <algorithm>
+#include <list>
 
 #include <skparmC.h>
 #include <sktqC.h>
@@ -12,6 +13,7 @@
 
 class TTree;
 class TQReal;
+class DeadtimeFilter;
 
 typedef struct OpeningAngleStats {
     float mean, median, stdev, skewness;
@@ -25,19 +27,44 @@ typedef struct HitReductionResult {
     Float tMin, tMax;
 } HitReductionResult;
 
+/** Number of vertices whose ToF-corrected hit order is cached in PMTHitCluster */
+#define NVERTEXCACHE 4
+
+/**
+ * @brief ToF, hit direction, and time order of hits for a given vertex.
+ * @details All vectors are indexed by the raw hit index (PMTHit::GetRawIndex).
+ */
+typedef struct VertexView {
+    TVector3 vertex;
+    std::vector<Float> tof;
+    std::vector<TVector3> direction;
+    std::vector<unsigned int> order;    ///< raw hit indices in order of ToF-subtracted hit time
+    std::vector<unsigned int> position; ///< position of each raw hit index in \c order
+} VertexView;
+
 class PMTHitCluster : public Cluster<PMTHit>, public TreeOut
 {
     public:
         PMTHitCluster();
-        PMTHitCluster(sktqz_common sktqz);
-        PMTHitCluster(sktqaz_common sktqaz);
-        PMTHitCluster(TQReal* tqreal, int flag=2/* default: in-gate */);
+        PMTHitCluster(const sktqz_common& sktqz);
+        PMTHitCluster(const sktqaz_common& sktqaz);
+        PMTHitCluster(const TQReal* tqreal, int flag=2/* default: in-gate */);
 
         void Append(const PMTHit& hit);
         void Append(const PMTHitCluster& hitCluster, bool inGateOnly=false);
         bool AppendByCoincidence(PMTHitCluster& hitCluster);
         void Clear();
-        void AddTQReal(TQReal* tqreal, int flag=2/* default: in-gate */);
+        /**
+         * @brief Appends the ID hits in the common \c sktqz, shifted by \c tOffset.
+         * @param inGateOnly If \c true, only in-gate hits are appended.
+         */
+        void AddSKTQZ(const sktqz_common& sktqz, Float tOffset=0, bool inGateOnly=false);
+        /**
+         * @brief Appends the OD hits in the common \c sktqaz, shifted by \c tOffset.
+         * @param inGateOnly If \c true, only in-gate hits are appended.
+         */
+        void AddSKTQAZ(const sktqaz_common& sktqaz, Float tOffset=0, bool inGateOnly=false);
+        void AddTQReal(const TQReal* tqreal, int flag=2/* default: in-gate */);
 
         void SetVertex(const TVector3& inVertex);
         inline const TVector3& GetVertex() const { return fVertex; }
@@ -54,6 +81,17 @@ class PMTHitCluster : public Cluster<PMTHit>, public TreeOut
         HitReductionResult RemoveLargeQHits(float qThreshold=10,
                                             Float tMin=-std::numeric_limits<Float>::infinity(), 
                                             Float tMax=std::numeric_limits<Float>::infinity());
+        /**
+         * @brief Returns the bad channel cut for ID hits, or for OD hits if this cluster has OD hits.
+         * @details The cut uses the bad channel and dark rate commons, so SKIO::SetBadChannels
+         * should be called beforehand.
+         */
+        std::function<bool(const PMTHit&)> GetBadChannelCut() const;
+        /**
+         * @brief Removes hits for which \c keep returns \c false in a single pass, keeping the hit order.
+         * @details \c keep is called once per hit in the current hit order and may modify the hit.
+         */
+        void FilterHits(std::function<bool(PMTHit&)> keep);
         unsigned int CountIf(std::function<bool(const PMTHit&)> lambda);
         unsigned int CountRange(Float tMin, Float tMax);
 
@@ -73,7 +111,12 @@ class PMTHitCluster : public Cluster<PMTHit>, public TreeOut
         PMTHitCluster SliceRange(Float startT, Float minusT, Float plusT);
         PMTHitCluster SliceRange(Float minusT, Float plusT);
 
-        unsigned int GetIndex(PMTHit hit);
+        /**
+         * @brief Returns the position of \c hit in this cluster, found by its hit ID.
+         * @details Each hit gets a hit ID when appended to a cluster,
+         * and slices keep the hit IDs of the original cluster.
+         */
+        unsigned int GetIndex(const PMTHit& hit);
         unsigned int GetLowerBoundIndex(Float t)
         {
             return std::lower_bound(fElement.begin(), fElement.end(), PMTHit(t, 0, 1, 1)) - fElement.begin();
@@ -87,7 +130,11 @@ class PMTHitCluster : public Cluster<PMTHit>, public TreeOut
         inline const TVector3& GetMeanDirection() const { return fMeanDirection; }
 
         void AddTimeOffset(Float tOffset);
-        HitReductionResult ApplyDeadtime(Float deadtime, bool doRemove=true);
+        /**
+         * @brief Applies PMT deadtime to all hits.
+         * @param filter A DeadtimeFilter to reuse for the per-PMT hit time tables (optional).
+         */
+        HitReductionResult ApplyDeadtime(Float deadtime, bool doRemove=true, DeadtimeFilter* filter=nullptr);
 
         template<typename T>
         float Find(std::function<T(const PMTHit&)> projFunc,
@@ -137,14 +184,27 @@ class PMTHitCluster : public Cluster<PMTHit>, public TreeOut
         void FillTree(bool asResidual=false);
 
     private:
-        bool fIsSorted, fHasVertex;
+        bool fIsSorted, fHasVertex, fIsRawIndexed, fIsOrderIndexed, fIsIDIndexed;
+        uint32_t fNextHitID;
+        std::vector<unsigned int> fRawIndexOfID;
         TVector3 fVertex, fMeanDirection;
 
+        // most recently used vertex first
+        std::list<VertexView> fVertexCache;
+
         std::vector<Float> fT, fToF, fDT;
         std::vector<float> fQ;
         std::vector<bool> fI, fS, fB, fTag;
 
-        void SetToF(bool unset=false);
+        void IndexRawHits();
+        void BuildIDIndex();
+        void InvalidateVertexCache()
+        {
+            fIsRawIndexed = false; fIsOrderIndexed = false; fIsIDIndexed = false;
+            fVertexCache.clear();
+        }
+        const VertexView& GetVertexView(const TVector3& vertex);
+        void ApplyVertexView(const VertexView& view);
 };
 
 PMTHitCluster operator+(const PMTHitCluster& hitCluster, const Float& time);